@@ -0,0 +1,457 @@
+/*
+ * Benchmark.cxx
+ *
+ * Copyright 2015 Joseph Lindgren <joseph.lindgren@uky.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/*
+ * Benchmarks: generates seeded random scenes of non-overlapping polygons
+ * and random queries between them, then times 'FindPath', 'OptimizePath'
+ * and 'ObstacleIntersection' over a sweep of obstacle and vertex counts.
+ * The timings are written to stdout as CSV (or JSON with "--format json"),
+ * one row per benchmark, coordinate type and scene size, with percentiles over the queries.
+ * Every coordinate type runs the same scenes: generated in float, then converted.
+ * With "--tile-size" the routes are found once more on a tiled scene of that tile size,
+ * which loads only the tiles they pass through.
+ * With "--regions" they are also planned through a region map with regions of that side (built untimed).
+ * With "--grid" they are also found on an occupancy grid with cells of that side (built untimed).
+ * With "--deadline" they are also found anytime, improved for at most that many microseconds each.
+ * With "--simplify" they are also found on the obstacles 'Simplify' coarsened to within that tolerance (untimed).
+ * With "--goal 1" the routes from their start points to the end of the first are looked up on a goal map (built untimed).
+ * With "--cache" they are asked twice through a route cache of that capacity, and the second round timed.
+ * With "--publish" they are also found on a shared scene while another thread updates an obstacle
+ * and publishes a new snapshot every that many microseconds.
+ *
+ * Usage: Benchmark [--obstacles 16,64,256,1024] [--vertices 8,32,128]
+ *                  [--queries 100] [--seed 1] [--format csv|json]
+ *                  [--coords float,double,fixed] [--tile-size 0] [--regions 0] [--grid 0] [--deadline 0]
+ *                  [--simplify 0] [--goal 0] [--cache 0] [--publish 0]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <unistd.h>
+
+#include "PathFinder.h"
+
+#define CELL_SIZE	10	// obstacles are laid out one per cell of a square grid
+
+volatile int bench_sink;	// keeps the compiler from dropping work whose result is unused
+
+struct SBenchResult
+{
+	string name, coords;
+	int obstacles, vertices;
+	vector<double> micros;	// one sample per query
+};
+
+void GenerateScene( int obstacles, int vertices, unsigned int seed, list<CObstacle> * scene, vector<SSeg> * queries, int num_queries )
+/* Fills 'scene' with 'obstacles' random star-shaped polygons of 'vertices' vertices each
+ * (closed by repeating the first point), one per cell of a square grid, so that none overlap.
+ * Every polygon keeps clear of its cell's border, so the 'queries' run between random points on the grid lines. */
+{
+	mt19937 rng(seed);
+	uniform_real_distribution<float> unit(0, 1);
+	int side = ceil( sqrt( (double)obstacles ) );
+
+	scene->clear();
+	for ( int n = 0; n < obstacles; n ++ )
+	{
+		float	cx = ( n % side + 0.5 ) * CELL_SIZE + ( unit(rng) - 0.5 ),
+				cy = ( n / side + 0.5 ) * CELL_SIZE + ( unit(rng) - 0.5 ),
+				turn = unit(rng) * 6.2831853;
+		list<CPair> pts;
+		for ( int v = 0; v < vertices; v ++ )
+		{
+			float	angle = turn + 6.2831853 * v / vertices,
+					radius = CELL_SIZE * ( 0.15 + 0.2 * unit(rng) );
+			pts.push_back( CPair( cx + radius * cos(angle), cy + radius * sin(angle) ) );
+		}
+		pts.push_back( pts.front() );
+		scene->push_back( CObstacle(&pts) );
+	}
+
+	queries->clear();
+	for ( int q = 0; q < num_queries; q ++ )
+	{
+		CPair ends[2];
+		for ( CPair & end : ends )
+		{
+			float	along = unit(rng) * side * CELL_SIZE,
+					across = ( rng() % (side + 1) ) * CELL_SIZE;
+			end = ( rng() % 2 ? CPair( along, across ) : CPair( across, along ) );
+		}
+		queries->push_back( { ends[0], ends[1] } );
+	}
+}
+
+double Percentile( vector<double> * sorted, double p )
+{
+	if ( sorted->empty() )
+		return 0;
+	int rank = ceil( p / 100 * sorted->size() ) - 1;
+	return (*sorted)[ max( 0, rank ) ];
+}
+
+template <class T>
+CPairT<T> ConvertPair( CPair pt )
+{
+	return CPairT<T>( SCoord<T>::From( pt.GetX() ), SCoord<T>::From( pt.GetY() ) );
+}
+
+template <class T>
+void RunScene( string coords, int obstacles, int vertices, unsigned int seed, int num_queries, double tile_size,
+			   double region_size, double cell_size, double deadline, double simplify, bool goal_map, int cache_size, double publish, vector<SBenchResult> * results )
+{
+	typedef chrono::steady_clock clock;
+	list<CObstacle> generated;
+	vector<SSeg> generated_queries;
+	GenerateScene( obstacles, vertices, seed, &generated, &generated_queries, num_queries );
+
+	list< CObstacleT<T> > scene;
+	vector< SSegT<T> > queries;
+	for ( CObstacle & obstacle : generated )
+	{
+		list< CPairT<T> > pts;
+		for ( CPair & pt : obstacle.GetPts() )
+			pts.push_back( ConvertPair<T>(pt) );
+		scene.push_back( CObstacleT<T>(&pts) );
+	}
+	for ( SSeg & seg : generated_queries )
+		queries.push_back( { ConvertPair<T>(seg.start), ConvertPair<T>(seg.end) } );
+
+	CObstacleIndexT<T> index(&scene);
+	SBenchResult	find = { "FindPath", coords, obstacles, vertices, {} },
+					optimize = { "OptimizePath", coords, obstacles, vertices, {} },
+					intersect = { "ObstacleIntersection", coords, obstacles, vertices, {} };
+	for ( SSegT<T> & seg : queries )
+	{
+		CPathMemoT<T> memo;
+		clock::time_point t0 = clock::now();
+		list< CPairT<T> > route = FindPath( seg, &index, 0, &memo );
+		clock::time_point t1 = clock::now();
+		OptimizePath( &route, &index, 0.001, &memo );
+		clock::time_point t2 = clock::now();
+
+		// the query segment against every obstacle, as 'FindPath' would meet them
+		int hits = 0;
+		for ( CObstacleT<T> & obstacle : scene )
+		{
+			list< SIsectDataT<T> > isects;
+			hits += ObstacleIntersection( seg, &obstacle, &isects, 0 );
+		}
+		clock::time_point t3 = clock::now();
+		bench_sink = hits;
+
+		find.micros.push_back( chrono::duration<double, micro>(t1 - t0).count() );
+		optimize.micros.push_back( chrono::duration<double, micro>(t2 - t1).count() );
+		intersect.micros.push_back( chrono::duration<double, micro>(t3 - t2).count() );
+	}
+	results->push_back(find);
+	results->push_back(optimize);
+	results->push_back(intersect);
+
+	if ( tile_size > 0 )
+	{
+		// the store maps a binary scene file, which can go once it is mapped
+		char path[] = "/tmp/PathFinderTiles.XXXXXX";
+		vector<SSeg> none;
+		int fd = mkstemp(path);
+		CTileStoreT<T> * store = 0;
+		if ( fd >= 0 )
+		{
+			close(fd);
+			if ( SaveSceneBinary( path, &generated, &none ) )
+				store = CTileStoreT<T>::Open( path, tile_size );
+			remove(path);
+		}
+		if ( !store )
+		{
+			cerr << "cannot write a scene file to tile" << endl;
+			exit(1);
+		}
+		CTiledSceneT<T> tiled( store, TILES_RESIDENT );
+		SBenchResult routed = { "TiledRoute", coords, obstacles, vertices, {} };
+		for ( SSegT<T> & seg : queries )
+		{
+			clock::time_point t0 = clock::now();
+			bench_sink = FindRoute<T>( seg, &tiled, 0.001 ).size();
+			routed.micros.push_back( chrono::duration<double, micro>(clock::now() - t0).count() );
+		}
+		results->push_back(routed);
+		delete store;
+	}
+
+	if ( region_size > 0 )
+	{
+		CSceneT<T> shared( &scene );
+		CRegionMapT<T> regions( &shared, region_size, 0.001, 0 );
+		SBenchResult planned = { "RegionRoute", coords, obstacles, vertices, {} };
+		for ( SSegT<T> & seg : queries )
+		{
+			clock::time_point t0 = clock::now();
+			bench_sink = FindRoute<T>( seg, &regions ).size();
+			planned.micros.push_back( chrono::duration<double, micro>(clock::now() - t0).count() );
+		}
+		results->push_back(planned);
+	}
+
+	if ( cell_size > 0 )
+	{
+		CSceneT<T> shared( &scene );
+		CGridMapT<T> grid( &shared, cell_size, 0.001 );
+		SBenchResult gridded = { "GridRoute", coords, obstacles, vertices, {} };
+		for ( SSegT<T> & seg : queries )
+		{
+			clock::time_point t0 = clock::now();
+			bench_sink = FindRoute<T>( seg, &grid ).size();
+			gridded.micros.push_back( chrono::duration<double, micro>(clock::now() - t0).count() );
+		}
+		results->push_back(gridded);
+	}
+
+	if ( deadline > 0 )
+	{
+		CSceneT<T> shared( &scene );
+		SBenchResult anytime = { "AnytimeRoute", coords, obstacles, vertices, {} };
+		for ( SSegT<T> & seg : queries )
+		{
+			clock::time_point t0 = clock::now();
+			SBudget budget = { StatsMicros() + deadline, 0 };
+			bench_sink = FindRoute<T>( seg, &shared, 0.001, &budget, 0 ).size();
+			anytime.micros.push_back( chrono::duration<double, micro>(clock::now() - t0).count() );
+		}
+		results->push_back(anytime);
+	}
+
+	if ( simplify > 0 )
+	{
+		list< CObstacleT<T> > coarse = Simplify( &scene, simplify );
+		CSceneT<T> simplified( &coarse );
+		SBenchResult routed = { "SimplifiedRoute", coords, obstacles, vertices, {} };
+		for ( SSegT<T> & seg : queries )
+		{
+			clock::time_point t0 = clock::now();
+			bench_sink = FindRoute<T>( seg, &simplified, SOLVER_CIRCUMVENT, 0.001 ).size();
+			routed.micros.push_back( chrono::duration<double, micro>(clock::now() - t0).count() );
+		}
+		results->push_back(routed);
+	}
+
+	if ( goal_map and !queries.empty() )
+	{
+		CSceneT<T> shared( &scene );
+		CGoalMapT<T> goals( &shared, queries[0].end );
+		SBenchResult looked_up = { "GoalRoute", coords, obstacles, vertices, {} };
+		for ( SSegT<T> & seg : queries )
+		{
+			clock::time_point t0 = clock::now();
+			bench_sink = FindRoute<T>( seg.start, &goals ).size();
+			looked_up.micros.push_back( chrono::duration<double, micro>(clock::now() - t0).count() );
+		}
+		results->push_back(looked_up);
+	}
+
+	if ( cache_size > 0 )
+	{
+		CSceneT<T> shared( &scene );
+		CRouteCacheT<T> cache( &shared, cache_size, 0 );
+		SBenchResult cached = { "CachedRoute", coords, obstacles, vertices, {} };
+		for ( SSegT<T> & seg : queries )
+			FindRoute<T>( seg, &cache, SOLVER_CIRCUMVENT, 0.001 );
+		for ( SSegT<T> & seg : queries )
+		{
+			clock::time_point t0 = clock::now();
+			bench_sink = FindRoute<T>( seg, &cache, SOLVER_CIRCUMVENT, 0.001 ).size();
+			cached.micros.push_back( chrono::duration<double, micro>(clock::now() - t0).count() );
+		}
+		results->push_back(cached);
+	}
+
+	if ( publish > 0 and !scene.empty() )
+	{
+		CSharedSceneT<T> shared( &scene, SOLVER_CIRCUMVENT );
+		vector< CObstacleT<T> > originals( scene.begin(), scene.end() );
+		atomic<bool> done( false );
+		thread writer( [&]()
+		{
+			for ( unsigned int n = 0; !done; n ++ )
+			{
+				shared.Update( n % originals.size(), &originals[ n % originals.size() ] );
+				shared.Publish();
+				this_thread::sleep_for( chrono::duration<double, micro>(publish) );
+			}
+		} );
+		int reader = shared.Join();
+		SBenchResult routed = { "SharedRoute", coords, obstacles, vertices, {} };
+		for ( SSegT<T> & seg : queries )
+		{
+			clock::time_point t0 = clock::now();
+			bench_sink = FindRoute<T>( seg, &shared, reader, 0.001 ).size();
+			routed.micros.push_back( chrono::duration<double, micro>(clock::now() - t0).count() );
+		}
+		shared.Leave(reader);
+		done = true;
+		writer.join();
+		results->push_back(routed);
+	}
+}
+
+void PrintResults( vector<SBenchResult> * results, bool json )
+{
+	if ( json )
+		cout << "[" << endl;
+	else
+		cout << "benchmark,coords,obstacles,vertices,samples,mean_us,p50_us,p90_us,p99_us,max_us" << endl;
+
+	for ( unsigned int i = 0; i < results->size(); i ++ )
+	{
+		SBenchResult & r = (*results)[i];
+		vector<double> sorted = r.micros;
+		sort( sorted.begin(), sorted.end() );
+		double mean = 0;
+		for ( double t : sorted )
+			mean += t / sorted.size();
+
+		char row[256];
+		if ( json )
+			snprintf( row, sizeof(row), "  {\"benchmark\": \"%s\", \"coords\": \"%s\", \"obstacles\": %d, \"vertices\": %d, \"samples\": %d, "
+					  "\"mean_us\": %.3f, \"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f}%s",
+					  r.name.c_str(), r.coords.c_str(), r.obstacles, r.vertices, (int)sorted.size(), mean,
+					  Percentile(&sorted, 50), Percentile(&sorted, 90), Percentile(&sorted, 99),
+					  sorted.empty() ? 0 : sorted.back(), i + 1 < results->size() ? "," : "" );
+		else
+			snprintf( row, sizeof(row), "%s,%s,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f",
+					  r.name.c_str(), r.coords.c_str(), r.obstacles, r.vertices, (int)sorted.size(), mean,
+					  Percentile(&sorted, 50), Percentile(&sorted, 90), Percentile(&sorted, 99),
+					  sorted.empty() ? 0 : sorted.back() );
+		cout << row << endl;
+	}
+
+	if ( json )
+		cout << "]" << endl;
+}
+
+vector<string> ParseWords( string arg )
+{
+	vector<string> words;
+	size_t pos = 0;
+	while ( pos < arg.size() )
+	{
+		size_t comma = arg.find( ',', pos );
+		if ( comma == string::npos )
+			comma = arg.size();
+		words.push_back( arg.substr( pos, comma - pos ) );
+		pos = comma + 1;
+	}
+	return words;
+}
+
+vector<int> ParseList( string arg )
+{
+	vector<int> values;
+	for ( string & word : ParseWords(arg) )
+		values.push_back( atoi( word.c_str() ) );
+	return values;
+}
+
+int main(int argc, char **argv)
+{
+	vector<int>	obstacle_counts = { 16, 64, 256, 1024 },
+				vertex_counts = { 8, 32, 128 };
+	int num_queries = 100;
+	vector<string> coord_types = { "float", "double", "fixed" };
+	unsigned int seed = 1;
+	double tile_size = 0;
+	double region_size = 0;
+	double cell_size = 0;
+	double deadline = 0;
+	double simplify = 0;
+	bool goal_map = false;
+	int cache_size = 0;
+	double publish = 0;
+	bool json = false;
+
+	for ( int i = 1; i + 1 < argc; i += 2 )
+	{
+		string opt = argv[i], val = argv[i+1];
+		if ( opt == "--obstacles" )
+			obstacle_counts = ParseList(val);
+		else if ( opt == "--vertices" )
+			vertex_counts = ParseList(val);
+		else if ( opt == "--queries" )
+			num_queries = atoi( val.c_str() );
+		else if ( opt == "--seed" )
+			seed = atoi( val.c_str() );
+		else if ( opt == "--format" )
+			json = ( val == "json" );
+		else if ( opt == "--coords" )
+			coord_types = ParseWords(val);
+		else if ( opt == "--tile-size" )
+			tile_size = atof( val.c_str() );
+		else if ( opt == "--regions" )
+			region_size = atof( val.c_str() );
+		else if ( opt == "--grid" )
+			cell_size = atof( val.c_str() );
+		else if ( opt == "--deadline" )
+			deadline = atof( val.c_str() );
+		else if ( opt == "--simplify" )
+			simplify = atof( val.c_str() );
+		else if ( opt == "--goal" )
+			goal_map = ( atoi( val.c_str() ) != 0 );
+		else if ( opt == "--cache" )
+			cache_size = atoi( val.c_str() );
+		else if ( opt == "--publish" )
+			publish = atof( val.c_str() );
+		else
+		{
+			cerr << "unknown option " << opt << endl;
+			return 1;
+		}
+	}
+
+	vector<SBenchResult> results;
+	for ( int obstacles : obstacle_counts )
+	{
+		for ( int vertices : vertex_counts )
+		{
+			for ( string & coords : coord_types )
+			{
+				if ( coords == "float" )
+					RunScene<float>( coords, obstacles, vertices, seed, num_queries, tile_size, region_size, cell_size, deadline, simplify, goal_map, cache_size, publish, &results );
+				else if ( coords == "double" )
+					RunScene<double>( coords, obstacles, vertices, seed, num_queries, tile_size, region_size, cell_size, deadline, simplify, goal_map, cache_size, publish, &results );
+				else if ( coords == "fixed" )
+					RunScene<int>( coords, obstacles, vertices, seed, num_queries, tile_size, region_size, cell_size, deadline, simplify, goal_map, cache_size, publish, &results );
+				else
+				{
+					cerr << "unknown coordinate type " << coords << endl;
+					return 1;
+				}
+			}
+		}
+	}
+	PrintResults( &results, json );
+	return 0;
+}
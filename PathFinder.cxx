@@ -1,5 +1,5 @@
 /*
- * tracker.cxx
+ * PathFinder.cxx
  * 
  * Copyright 2015 Joseph Lindgren <joseph.lindgren@uky.edu>
  * 
@@ -36,59 +36,34 @@
  */
 
 
-#include <iostream>
 #include <stdio.h>
-#include <string>
 #include <cmath>
-#include <list>
-
-#define RIGHT	true
-#define LEFT	false
-#define DEBUGGING  false
-
-using namespace std;
+#include <algorithm>
+#include <queue>
+#include <chrono>
+#include <atomic>
+#include <limits>
+#include <cstddef>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-class CPair
-{
-	private:
-		float x,y;
-		bool on_obstacle, clockwise;
-		bool side;
+#include "PathFinder.h"
 
-	public:
-		CPair();
-		CPair(float x, float y);
-		CPair(float x, float y, bool on_obstacle, bool clockwise);
-		
-		void SetClockwise(bool cw);
-		bool GetClockwise(void);
-		void SetOnObstacle(bool on_obs);
-		bool GetOnObstacle(void);
-		void SetSide(bool side);
-		bool GetSide(void);
-		
-		CPair & operator=( const CPair & other );
-		bool operator==( const CPair & other );
-		CPair & operator+=( const CPair & other );
-		CPair & operator-=( const CPair & other );
-		const CPair operator+( const CPair & rhs );
-		const CPair operator-( const CPair & rhs );
-		float operator*( const CPair & rhs );
-		const CPair operator*( float scalar );
-
-		string SPrint(void);
-		float GetX(void);
-		float GetY(void);
-		
-		float Angle( CPair other );
-		CPair Normal(void);
-};
 
-CPair::CPair()
+template <class T>
+CPairT<T>::CPairT()
 {
 }
 
-CPair::CPair(float x, float y)
+template <class T>
+CPairT<T>::CPairT(T x, T y)
 {
 	this->x = x;
 	this->y = y;
@@ -98,7 +73,8 @@ CPair::CPair(float x, float y)
 	this->side = RIGHT;//added to fix valgrind complaint of uninit'd value
 }
 
-CPair::CPair(float x, float y, bool on_obstacle, bool clockwise)
+template <class T>
+CPairT<T>::CPairT(T x, T y, bool on_obstacle, bool clockwise)
 {
 	this->x = x;
 	this->y = y;
@@ -107,37 +83,44 @@ CPair::CPair(float x, float y, bool on_obstacle, bool clockwise)
 	this->clockwise = clockwise;
 }
 
-void CPair::SetClockwise(bool cw)
+template <class T>
+void CPairT<T>::SetClockwise(bool cw)
 {
 	this->clockwise = cw;
 }
 
-bool CPair::GetClockwise(void)
+template <class T>
+bool CPairT<T>::GetClockwise(void)
 {
 	return this->clockwise;
 }
 
-void CPair::SetOnObstacle(bool on_obs)
+template <class T>
+void CPairT<T>::SetOnObstacle(bool on_obs)
 {
 	this->on_obstacle = on_obs;
 }
 
-bool CPair::GetOnObstacle(void)
+template <class T>
+bool CPairT<T>::GetOnObstacle(void)
 {
 	return this->on_obstacle;
 }
 
-void CPair::SetSide(bool side)
+template <class T>
+void CPairT<T>::SetSide(bool side)
 {
 	this->side = side;
 }
 
-bool CPair::GetSide(void)
+template <class T>
+bool CPairT<T>::GetSide(void)
 {
 	return this->side;
 }
 
-CPair & CPair::operator=( const CPair & other )
+template <class T>
+CPairT<T> & CPairT<T>::operator=( const CPairT<T> & other )
 {
 	this->x = other.x;
 	this->y = other.y;
@@ -147,7 +130,8 @@ CPair & CPair::operator=( const CPair & other )
 	return *this;
 }
 
-bool CPair::operator==( const CPair & other )
+template <class T>
+bool CPairT<T>::operator==( const CPairT<T> & other )
 {
 	if ( (this->x == other.x) and (this->y == other.y) )
 		return true;
@@ -155,57 +139,66 @@ bool CPair::operator==( const CPair & other )
 		return false;
 }
 
-CPair & CPair::operator+=( const CPair & other )
+template <class T>
+CPairT<T> & CPairT<T>::operator+=( const CPairT<T> & other )
 {
 	this->x += other.x;
 	this->y += other.y;
 	return *this;
 }
 
-CPair & CPair::operator-=( const CPair & other )
+template <class T>
+CPairT<T> & CPairT<T>::operator-=( const CPairT<T> & other )
 {
 	this->x -= other.x;
 	this->y -= other.y;
 	return *this;
 }
 
-const CPair CPair::operator+( const CPair & rhs )
+template <class T>
+const CPairT<T> CPairT<T>::operator+( const CPairT<T> & rhs )
 {
-	CPair result(this->x, this->y);
+	CPairT<T> result(this->x, this->y);
 	result += rhs;
 	return result;
 }
 
-const CPair CPair::operator-( const CPair & rhs )
+template <class T>
+const CPairT<T> CPairT<T>::operator-( const CPairT<T> & rhs )
 {
-	CPair result(this->x, this->y);
+	CPairT<T> result(this->x, this->y);
 	result -= rhs;
 	return result;
 }
 
-float CPair::operator*( const CPair & rhs )
+template <class T>
+typename CPairT<T>::real CPairT<T>::operator*( const CPairT<T> & rhs )
 // Returns the dot product of 'this' pair with 'rhs'
 {
-	return (this->x * rhs.x + this->y * rhs.y);
+	return ((real)this->x * rhs.x + (real)this->y * rhs.y);
 }
 
-const CPair CPair::operator*( float scalar )
-// Returns a scalar multiple of 'this' pair
+template <class T>
+const CPairT<T> CPairT<T>::operator*( real scalar )
+// Returns a scalar multiple of 'this' pair (rounded to the nearest one that 'T' holds)
 {
-	return CPair( scalar * this->x, scalar * this->y );
+	return CPairT<T>( SCoord<T>::Near( scalar * this->x ), SCoord<T>::Near( scalar * this->y ) );
 }
 
 ///
 
-string CPair::SPrint(void)
+template <class T>
+string CPairT<T>::SPrint(void)
 // Returns a string describing the pair
 {
 	char * pair;
+	double	x = SCoord<T>::Value(this->x),
+			y = SCoord<T>::Value(this->y);
 	pair = new char[50];
-	if ( (int)(this->x) == this->x )
-		snprintf( pair, 50, "(%d,%d)", (int)(this->x), (int)(this->y) );
+	if ( (int)(x) == x )
+		snprintf( pair, 50, "(%d,%d)", (int)(x), (int)(y) );
 	else
-		snprintf( pair, 50, "(%f,%f)", this->x, this->y);
+		snprintf( pair, 50, "(%f,%f)", x, y);
 	
 	string str;
 	str.assign(pair);
@@ -213,22 +206,25 @@ string CPair::SPrint(void)
 	return str;
 }
 
-float CPair::GetX(void)
+template <class T>
+T CPairT<T>::GetX(void)
 {
 	return this->x;
 }
 
-float CPair::GetY(void)
+template <class T>
+T CPairT<T>::GetY(void)
 {
 	return this->y;
 }
 		
-float CPair::Angle( CPair other )
+template <class T>
+typename CPairT<T>::real CPairT<T>::Angle( CPairT<T> other )
 // Returns the angle from 'this' to 'other' (vector) pair
 {
-	CPair v = *this, w = other;
-	float radians = 0, cosine = 0, sign = 0;
-	float denom = sqrt(( v * v ) * ( w * w ));
+	CPairT<T> v = *this, w = other;
+	real radians = 0, cosine = 0, sign = 0;
+	real denom = sqrt(( v * v ) * ( w * w ));
 
 	if ( denom == 0 )
 		return 0;
@@ -244,18 +240,20 @@ float CPair::Angle( CPair other )
 	return radians * 180 / 3.141592654;
 }
 
-CPair CPair::Normal(void)
+template <class T>
+CPairT<T> CPairT<T>::Normal(void)
 {
-	CPair v;
+	CPairT<T> v;
 	v.x = - this->y;
 	v.y = 	this->x;
 	return v;
 }
 
-void PrintPath( list<CPair> * path )
+template <class T>
+void PrintPath( list< CPairT<T> > * path )
 {
 	cout << "[(start)";
-	for ( CPair & pt : *path )
+	for ( CPairT<T> & pt : *path )
 	{
 		cout << ( pt.GetSide() ? "-R" : "-L" )
 			 << pt.SPrint();
@@ -263,629 +261,4475 @@ void PrintPath( list<CPair> * path )
 	cout << "(end)]" << endl;
 }
 
-void PrintWXMaxGraph( list<CPair> * path, string blurb )
+template <class T>
+void PrintPath( CArenaPathT<T> * path )
+{
+	list< CPairT<T> > copy( path->begin(), path->end() );
+	PrintPath(&copy);
+}
+
+template <class T>
+void PrintWXMaxGraph( list< CPairT<T> > * path, string blurb )
 {
 	cout << "(Approx.) wxMaxima code to visualize the " << blurb << endl
 		 << " (delete trailing commas in coord lists):" << endl;
 	cout << "wxplot2d([discrete," << endl << '[';
-	for ( CPair & pt : *path )
-		cout << pt.GetX() << ',';
+	for ( CPairT<T> & pt : *path )
+		cout << SCoord<T>::Value( pt.GetX() ) << ',';
 	cout << "]," << endl << '[';
-	for ( CPair & pt : *path )
-		cout << pt.GetY() << ',';
+	for ( CPairT<T> & pt : *path )
+		cout << SCoord<T>::Value( pt.GetY() ) << ',';
 	cout << "]]," << endl;
 	cout << "[x,0,35],[y,0,35])" << endl;
 }
 
-list<CPair> ConcatPaths( list<CPair> * path1, list<CPair> * path2 )
+template <class T>
+list< CPairT<T> > ConcatPaths( list< CPairT<T> > * path1, list< CPairT<T> > * path2 )
 {
-	list<CPair> result;
-	for ( CPair & pt : *path1 )
+	list< CPairT<T> > result;
+	for ( CPairT<T> & pt : *path1 )
 		result.push_back(pt);
-	for ( CPair & pt : *path2 )
+	for ( CPairT<T> & pt : *path2 )
 		result.push_back(pt);
 	return result;
 }
 
-list<CPair> ConcatPaths( list<list<CPair> *> paths )
+template <class T>
+list< CPairT<T> > ConcatPaths( list< list< CPairT<T> > * > paths )
 {
-	list<CPair> result;
-	for ( list<CPair> * path : paths )
+	list< CPairT<T> > result;
+	for ( list< CPairT<T> > * path : paths )
 	{
-		for ( CPair & pt : *path )
+		for ( CPairT<T> & pt : *path )
 			result.push_back(pt);
 	}
 	return result;
 }
 
-struct SSeg
+template <class T>
+void PrintSeg( SSegT<T> seg )
 {
-	CPair start, end;
-};
+	cout << '[' << seg.start.SPrint() << ", " << seg.end.SPrint() << ']' << endl; 
+}
 
-void PrintSeg( SSeg seg )
+template <class T>
+SBoxT<T> BoxOf( CPairT<T> pt )
 {
-	cout << '[' << seg.start.SPrint() << ", " << seg.end.SPrint() << ']' << endl; 
+	return { pt.GetX(), pt.GetY(), pt.GetX(), pt.GetY() };
+}
+
+template <class T>
+SBoxT<T> BoxUnion( SBoxT<T> a, SBoxT<T> b )
+{
+	return { min(a.xmin, b.xmin), min(a.ymin, b.ymin), max(a.xmax, b.xmax), max(a.ymax, b.ymax) };
 }
 
-class CObstacle
+template <class T>
+bool BoxesOverlap( SBoxT<T> a, SBoxT<T> b )
 {
-	private:
-		list<CPair> pts;
+	return ( a.xmin <= b.xmax and b.xmin <= a.xmax and a.ymin <= b.ymax and b.ymin <= a.ymax );
+}
 
-	public:
-		CObstacle();
-		CObstacle( list<CPair> * pts );
-		CObstacle & operator=( const CObstacle & rhs );
-		CObstacle & operator+( const CObstacle & rhs );
+template <class T>
+SBoxT<T> BoxPad( SBoxT<T> box )
+/* Grows 'box' by a margin comfortably larger than the rounding error of 'SegIntersect',
+ * so that culling with it never rejects an intersection that the edge math would report. */
+{
+	double	mag = max( max(fabs(box.xmin), fabs(box.xmax)), max(fabs(box.ymin), fabs(box.ymax)) );
+	T		pad = SCoord<T>::Up( SCoord<T>::Slack() * (1 + mag) );
+	return { box.xmin - pad, box.ymin - pad, box.xmax + pad, box.ymax + pad };
+}
 
-		void push_back( CPair pt );
-		unsigned int size( void );
-		list<CPair> GetPts(void);
-		void Print(void);
-		
-		int Index(CPair pt); // returns the offset of the first match to 'pt'
-		int Split( CPair split_pt, list<CPair> * part1, list<CPair> * part2 ); // splits a list at 'split_pt' and sets each parts to include 'split_pt'. Returns the zero-based index of 'split_pt'
-		CObstacle Subset( int start, int end );
-		bool Segment( int segpos, SSeg * segment );
-		void Reverse(void);
-};
+template <class T>
+bool BoxHitsSeg( SBoxT<T> box, SSegT<T> seg )
+/* Conservative segment-vs-box test (separating axes: the two box axes and the segment normal).
+ * Returns false only if 'seg' certainly misses 'box'. */
+{
+	double	ax = seg.start.GetX(), ay = seg.start.GetY(),
+			bx = seg.end.GetX(),   by = seg.end.GetY();
+
+	// the box axes
+	if (	max(ax, bx) < box.xmin or min(ax, bx) > box.xmax
+		 or max(ay, by) < box.ymin or min(ay, by) > box.ymax )
+		return false;
+
+	// the segment normal: the box is missed if all its corners lie strictly on one side
+	double	dx = bx - ax, dy = by - ay,
+			s1 = dx * (box.ymin - ay) - dy * (box.xmin - ax),
+			s2 = dx * (box.ymin - ay) - dy * (box.xmax - ax),
+			s3 = dx * (box.ymax - ay) - dy * (box.xmin - ax),
+			s4 = dx * (box.ymax - ay) - dy * (box.xmax - ax);
+	if ( (s1 > 0 and s2 > 0 and s3 > 0 and s4 > 0) or (s1 < 0 and s2 < 0 and s3 < 0 and s4 < 0) )
+		return false;
+
+	return true;
+}
+
+template <class T>
+int BuildBVH( vector< SBVHNodeT<T> > * nodes, vector< SBoxT<T> > * boxes, int lo, int hi )
+/* Builds the hierarchy over the items lo ... hi-1 of 'boxes' by halving the index range.
+ * Used where the order of the items already keeps neighbours together.
+ * Returns the index of the subtree root in 'nodes'. */
+{
+	int root = nodes->size();
+	SBoxT<T> box = (*boxes)[lo];
+	for ( int i = lo + 1; i < hi; i ++ )
+		box = BoxUnion( box, (*boxes)[i] );
+	nodes->push_back( { box, lo, hi - lo } );
 
-CObstacle::CObstacle()
+	if ( hi - lo > BVH_LEAF_SIZE )
+	{
+		int mid = lo + (hi - lo) / 2;
+		BuildBVH( nodes, boxes, lo, mid );
+		int right = BuildBVH( nodes, boxes, mid, hi ); // may reallocate 'nodes'
+		(*nodes)[root].first = right;
+		(*nodes)[root].count = 0;
+	}
+	return root;
+}
+
+template <class T, class TInts>
+int QueryBVH( vector< SBVHNodeT<T> > * nodes, SSegT<T> seg, TInts * hits )
+/* Appends to 'hits' every item whose leaf box 'seg' may cross, in increasing item order.
+ * Returns the number of items appended. */
+{
+	int num = 0, stack[64], top = 0;
+	if ( nodes->empty() )
+		return 0;
+	stack[top++] = 0;
+	while ( top > 0 )
+	{
+		SBVHNodeT<T> & node = (*nodes)[ stack[--top] ];
+		if ( !BoxHitsSeg( node.box, seg ) )
+			continue;
+		if ( node.count > 0 )
+		{
+			for ( int i = node.first; i < node.first + node.count; i ++ )
+				hits->push_back(i), num ++;
+		}
+		else
+		{	// push right first so that the left subtree (lower items) is visited first
+			stack[top++] = node.first;
+			stack[top++] = &node - &nodes->front() + 1;
+		}
+	}
+	return num;
+}
+
+bool StripNearSeg( SStrip * strip, double ax, double ay, double bx, double by, double reach )
+/* Checks the box first, then compares the distance between the two segments with the strip's width (plus 'reach'):
+ * it is zero if they cross, and otherwise that from one of the four end points to the other segment. */
 {
+	if (	max(ax, bx) < strip->xmin - reach or min(ax, bx) > strip->xmax + reach
+		 or max(ay, by) < strip->ymin - reach or min(ay, by) > strip->ymax + reach )
+		return false;
+	if ( !strip->thin )
+		return true;
+
+	double	sx = strip->bx - strip->ax, sy = strip->by - strip->ay,
+			dx = bx - ax, dy = by - ay,
+			radius = strip->width + reach;
+	auto Dist2 = []( double px, double py, double x0, double y0, double ux, double uy )
+	{
+		double	len2 = ux * ux + uy * uy,
+				t = ( len2 > 0 ? max( 0.0, min( 1.0, ( (px - x0) * ux + (py - y0) * uy ) / len2 ) ) : 0 ),
+				ex = px - x0 - t * ux, ey = py - y0 - t * uy;
+		return ex * ex + ey * ey;
+	};
+
+	double	o1 = dx * (strip->ay - ay) - dy * (strip->ax - ax),
+			o2 = dx * (strip->by - ay) - dy * (strip->bx - ax),
+			o3 = sx * (ay - strip->ay) - sy * (ax - strip->ax),
+			o4 = sx * (by - strip->ay) - sy * (bx - strip->ax);
+	if ( ( (o1 < 0 and o2 > 0) or (o1 > 0 and o2 < 0) ) and ( (o3 < 0 and o4 > 0) or (o3 > 0 and o4 < 0) ) )
+		return true;
+	double d2 = min( min( Dist2( ax, ay, strip->ax, strip->ay, sx, sy ), Dist2( bx, by, strip->ax, strip->ay, sx, sy ) ),
+					 min( Dist2( strip->ax, strip->ay, ax, ay, dx, dy ), Dist2( strip->bx, strip->by, ax, ay, dx, dy ) ) );
+	return d2 <= radius * radius;
+}
+
+template <class T>
+CObstacleT<T>::CObstacleT()
+{
+	this->num_axes = 0;
+	this->pad = 0;
+	this->bvh_dirty = true;
 }
 
-CObstacle::CObstacle( list<CPair> * points )
+template <class T>
+CObstacleT<T>::CObstacleT( list< CPairT<T> > * points )
 {
-	for ( CPair & pt : * points )
+	this->xs.reserve( points->size() );
+	this->ys.reserve( points->size() );
+	this->flags.reserve( points->size() );
+	for ( CPairT<T> & pt : * points )
 	{
 		pt.SetOnObstacle(true);
 		pt.SetClockwise(false);
 		//~ pt.SetSide(RIGHT);
 		
-		this->pts.push_back(pt);
+		this->push_back(pt);
+	}
+	this->bvh_dirty = true;
+	this->BuildIndex();
+}
+
+template <class T>
+CObstacleT<T>::CObstacleT( const T * x, const T * y, unsigned int n, bool close )
+{
+	close = ( close and n > 1 and ( x[0] != x[n-1] or y[0] != y[n-1] ) );
+	this->xs.reserve( n + close );
+	this->ys.reserve( n + close );
+	this->xs.assign( x, x + n );
+	this->ys.assign( y, y + n );
+	if ( close )
+	{
+		this->xs.push_back( x[0] );
+		this->ys.push_back( y[0] );
 	}
+	this->flags.assign( this->xs.size(), PT_ON_OBSTACLE | ( RIGHT ? PT_SIDE : 0 ) );
+	this->bvh_dirty = true;
+	this->BuildIndex();
 }
 
-CObstacle & CObstacle::operator=( const CObstacle & rhs )
+template <class T>
+CObstacleT<T> & CObstacleT<T>::operator=( const CObstacleT<T> & rhs )
 {
 	if (this == &rhs)
 		return *this;
 
-	this->pts.clear();
-	for ( CPair pt : rhs.pts )
-		this->pts.push_back(pt);
+	this->xs = rhs.xs;
+	this->ys = rhs.ys;
+	this->flags = rhs.flags;
+	this->strips = rhs.strips;
+	this->bounds = rhs.bounds;
+	this->hull = rhs.hull;
+	copy( rhs.axes, rhs.axes + rhs.num_axes, this->axes );
+	this->num_axes = rhs.num_axes;
+	this->pad = rhs.pad;
+	this->bvh_dirty = rhs.bvh_dirty;
 	return *this;
 }
 
-CObstacle & CObstacle::operator+( const CObstacle & rhs )
+template <class T>
+CObstacleT<T> & CObstacleT<T>::operator+( const CObstacleT<T> & rhs )
 {
-	for ( CPair pt : rhs.pts )
-		this->pts.push_back(pt);
+	this->xs.insert( this->xs.end(), rhs.xs.begin(), rhs.xs.end() );
+	this->ys.insert( this->ys.end(), rhs.ys.begin(), rhs.ys.end() );
+	this->flags.insert( this->flags.end(), rhs.flags.begin(), rhs.flags.end() );
+	this->bvh_dirty = true;
 	return *this;
 }
 
-void CObstacle::push_back( CPair pt )
+template <class T>
+void CObstacleT<T>::push_back( CPairT<T> pt )
 {
-	this->pts.push_back(pt);
+	this->xs.push_back( pt.GetX() );
+	this->ys.push_back( pt.GetY() );
+	this->flags.push_back( ( pt.GetOnObstacle() ? PT_ON_OBSTACLE : 0 )
+						 | ( pt.GetClockwise()  ? PT_CLOCKWISE   : 0 )
+						 | ( pt.GetSide()       ? PT_SIDE        : 0 ) );
+	this->bvh_dirty = true;
 }
 
-unsigned int CObstacle::size(void)
+template <class T>
+unsigned int CObstacleT<T>::size(void)
 {
-	return this->pts.size();
+	return this->xs.size();
 }
 
-list<CPair> CObstacle::GetPts(void)
+template <class T>
+list< CPairT<T> > CObstacleT<T>::GetPts(void)
 {
-	return this->pts;
+	list< CPairT<T> > pts;
+	for ( unsigned int i = 0; i < this->size(); i ++ )
+		pts.push_back( this->Pt(i) );
+	return pts;
 }
 
-void CObstacle::Print(void)
+template <class T>
+SPtsViewT<T> CObstacleT<T>::Pts(void)
 {
-	PrintPath(&this->pts);
+	return { this->xs.data(), this->ys.data(), (unsigned int)this->xs.size() };
 }
 
-int CObstacle::Split( CPair split_pt, list<CPair> * part1, list<CPair> * part2 )
+template <class T>
+CPairT<T> CObstacleT<T>::Pt( int i )
 {
-	bool before = true;
-	int n = 0;
-	part1->clear(), part2->clear();
-	for ( CPair & pt : this->pts )
-	{
-		if ( before )
-		{
-			part1->push_back(pt);
-			n ++;
-		}
+	CPairT<T> pt( this->xs[i], this->ys[i], this->flags[i] & PT_ON_OBSTACLE, this->flags[i] & PT_CLOCKWISE );
+	pt.SetSide( this->flags[i] & PT_SIDE );
+	return pt;
+}
 
-		if ( pt == split_pt )
-		{
-			before = false;
-			n --;
-		}
+template <class T>
+void CObstacleT<T>::Print(void)
+{
+	list< CPairT<T> > pts = this->GetPts();
+	PrintPath(&pts);
+}
 
-		if ( !before )
-			part2->push_back(pt);
+template <class T>
+int CObstacleT<T>::Index( CPairT<T> pt )
+{
+	for ( unsigned int i = 0; i < this->size(); i ++ )
+	{
+		if ( this->xs[i] == pt.GetX() and this->ys[i] == pt.GetY() )
+			return i;
 	}
-	return n;
+	return -1;
 }
 
+template <class T>
+int CObstacleT<T>::Vertex( int i )
+{
+	int n = this->size();
+	if ( i == n - 1 and n > 1 and this->xs[0] == this->xs[i] and this->ys[0] == this->ys[i] )
+		return 0;
+	return i;
+}
 
-void CObstacle::Reverse(void)
+template <class T>
+int CObstacleT<T>::Split( CPairT<T> split_pt, list< CPairT<T> > * part1, list< CPairT<T> > * part2 )
 {
-	this->pts.reverse();
-	for ( CPair & pt : this->pts )
+	int n = this->Index(split_pt);
+	part1->clear(), part2->clear();
+	for ( int i = 0; i < (int)this->size(); i ++ )
 	{
-		pt.SetClockwise( not pt.GetClockwise() ); // toggle cwise and ctrcwise
-		pt.SetSide( not pt.GetSide() ); // toggle LEFT to RIGHT and vice versa
+		if ( n < 0 or i <= n )
+			part1->push_back( this->Pt(i) );
+		if ( n >= 0 and i >= n )
+			part2->push_back( this->Pt(i) );
 	}
+	return ( n < 0 ? this->size() : n );
 }
 
-//Non-member functions ///////////////////////////////////////////////////////////////////
+template <class T>
+int CObstacleT<T>::Split( int split, SPtsViewT<T> * part1, SPtsViewT<T> * part2 )
+{
+	SPtsViewT<T> all = this->Pts();
+	*part1 = { all.x, all.y, (unsigned int)split + 1 };
+	*part2 = { all.x + split, all.y + split, all.n - split };
+	return split;
+}
 
-bool Solve2by2System( float A, float B, float a, float b, float c, float d, CPair * soln )
-/* Solves
- * A = ax + by
- * B = cx + dy
- * and returns the pair (x,y) */
+template <class T>
+bool CObstacleT<T>::Segment( int segpos, SSegT<T> * segment )
 {
-	float denom = b * c - a * d;
-	
-	if ( denom == 0 )
-		return 0;
-	else
+	if ( segpos < 0 or segpos + 1 >= (int)this->size() )
+		return false;
+	*segment = { this->Pt(segpos), this->Pt(segpos + 1) };
+	return true;
+}
+
+template <class T>
+void CObstacleT<T>::Reverse(void)
+{
+	reverse( this->xs.begin(), this->xs.end() );
+	reverse( this->ys.begin(), this->ys.end() );
+	reverse( this->flags.begin(), this->flags.end() );
+	for ( unsigned char & f : this->flags )
+		f ^= PT_CLOCKWISE | PT_SIDE; // toggle cwise and ctrcwise, and LEFT to RIGHT and vice versa
+	this->bvh_dirty = true;
+}
+
+template <class T>
+void CObstacleT<T>::BuildIndex(void)
+{
+	if ( !this->bvh_dirty )
+		return;
+	this->strips.clear();
+	this->bvh_dirty = false;
+	this->BuildHull();
+	if ( this->size() == 0 )
 	{
-		*soln = CPair( (b*B-d*A)/denom, (c*A-a*B)/denom );
-		return 1;
+		this->bounds = SBoxT<T>{ 0, 0, 0, 0 };
+		return;
 	}
+
+	SBoxT<T> box = BoxOf( this->Pt(0) );
+	for ( unsigned int i = 1; i < this->size(); i ++ )
+		box = BoxUnion( box, BoxOf( CPairT<T>( this->xs[i], this->ys[i] ) ) );
+	this->bounds = BoxPad(box);
+	if ( this->size() > 1 )
+		this->BuildStrips( 0, this->size() - 1 );
 }
 
-bool SegIntersect( CPair seg1start, CPair seg1end, CPair seg2start, CPair seg2end, float * kappa, CPair * isect )
-/* If an intersection DOES exist:
- * 		we return success,
- * 		set 'isect' as the point of intersection,
- * 		and set 'kappa' to indicate how far along the first segment the intersection lies.
- * 		( we have 0 <= k <= 1 if an intersection exists )
- * If an intersection does NOT exist:
- * 		return failure,
- * 		do not set 'kappa'. */
+template <class T>
+int CObstacleT<T>::BuildStrips( int first, int last )
+/* Halves the run, like 'BuildBVH': splitting at the farthest vertex instead (as Douglas-Peucker would)
+ * makes the strips of a jagged outline no thinner, and the tree lopsided.
+ * Returns the index of the subtree root in 'strips'. */
 {
-	CPair	a = seg1start,
-			b = seg1end,
-			c = seg2start,
-			d = seg2end;
-	float	A = a.GetX() - c.GetX(),
-			B = a.GetY() - c.GetY();
-	CPair	alpha = a - b,
-			beta  = d - c;
-	CPair	soln;
+	SStrip strip = { (double)this->xs[first], (double)this->ys[first], (double)this->xs[last], (double)this->ys[last], 0,
+					   HUGE_VAL, HUGE_VAL, -HUGE_VAL, -HUGE_VAL, first, last - first, 0, false };
+	double	sx = strip.bx - strip.ax, sy = strip.by - strip.ay,
+			len2 = sx * sx + sy * sy, far2 = -1;
+	int root = this->strips.size();
+	for ( int i = first; i <= last; i ++ )
+	{
+		strip.xmin = min( strip.xmin, (double)this->xs[i] ), strip.xmax = max( strip.xmax, (double)this->xs[i] );
+		strip.ymin = min( strip.ymin, (double)this->ys[i] ), strip.ymax = max( strip.ymax, (double)this->ys[i] );
+	}
+	for ( int i = first + 1; i < last; i ++ )
+	{
+		double	px = this->xs[i] - strip.ax, py = this->ys[i] - strip.ay,
+				t = ( len2 > 0 ? max( 0.0, min( 1.0, ( px * sx + py * sy ) / len2 ) ) : 0 ),
+				ex = px - t * sx, ey = py - t * sy,
+				d2 = ex * ex + ey * ey;
+		far2 = max( far2, d2 );
+	}
+	strip.width = sqrt( max( far2, 0.0 ) );
+	strip.thin = ( 4 * strip.width * sqrt(len2) < ( strip.xmax - strip.xmin ) * ( strip.ymax - strip.ymin ) );
+	this->strips.push_back(strip);
 
-	//If no intersection (no soln or !(0 <= k <= 1) ), return failure
-	if (	!Solve2by2System( A, B, alpha.GetX(), beta.GetX(), alpha.GetY(), beta.GetY(), &soln )
-		 or (soln.GetX() > 1) or (soln.GetX() < 0) or (soln.GetY() > 1) or (soln.GetY() < 0) )
+	if ( last - first > BVH_LEAF_SIZE )
+	{
+		int split = ( first + last ) / 2;
+		this->BuildStrips( first, split );
+		int right = this->BuildStrips( split, last ); // may reallocate 'strips'
+		this->strips[root].right = right;
+	}
+	return root;
+}
+
+template <class T>
+SBoxT<T> CObstacleT<T>::Bounds(void)
+{
+	this->BuildIndex();
+	return this->bounds;
+}
+
+template <class T>
+template <class TInts>
+int CObstacleT<T>::EdgeCandidates( SSegT<T> seg, TInts * edges )
+/* Walks the strip tree from the coarsest outline down, only into the strips 'seg' comes near
+ * (allowing the same margin for rounding as 'Misses'), and appends the edges of the leaves it reaches. */
+{
+	int num = 0, stack[64], top = 0;
+	this->BuildIndex();
+	if ( this->strips.empty() )
 		return 0;
 
-	//Otherwise, set 'kappa' and 'isect' and return success
-	else
+	double	ax = seg.start.GetX(), ay = seg.start.GetY(),
+			bx = seg.end.GetX(),   by = seg.end.GetY(),
+			reach = max( this->pad, SCoord<T>::Slack() * ( 1 + max( max(fabs(ax), fabs(ay)), max(fabs(bx), fabs(by)) ) ) );
+	stack[top++] = 0;
+	while ( top > 0 )
 	{
-		*kappa = soln.GetX();
-		*isect = a - alpha * (*kappa);
-		return 1;
+		SStrip & strip = this->strips[ stack[--top] ];
+		if ( !StripNearSeg( &strip, ax, ay, bx, by, reach ) )
+			continue;
+		if ( !strip.right )
+		{
+			for ( int i = strip.first; i < strip.first + strip.count; i ++ )
+				edges->push_back(i), num ++;
+		}
+		else
+		{	// push right first so that the left subtree (lower edges) is visited first
+			stack[top++] = strip.right;
+			stack[top++] = &strip - &this->strips.front() + 1;
+		}
 	}
+	return num;
 }
 
-bool SegIntersect( SSeg seg1, SSeg seg2, float * kappa, CPair * isect )
-/* If an intersection DOES exist:
- * 		we return success,
- * 		set 'isect' as the point of intersection,
- * 		and set 'kappa' to indicate how far along the first segment the intersection lies.
- * 		( we have 0 <= k <= 1 if an intersection exists )
- * If an intersection does NOT exist:
- * 		return failure,
- * 		do not set 'kappa. */
+template <class T>
+void CObstacleT<T>::BuildHull(void)
+/* Finds the convex hull of the vertices (Andrew's monotone chain, with the exact 'OrientSign'), and keeps up to
+ * HULL_AXES of its edges, spread evenly around it, as separating axes. */
 {
-	CPair	a = seg1.start,
-			b = seg1.end,
-			c = seg2.start,
-			d = seg2.end;
-	float	A = a.GetX() - c.GetX(),
-			B = a.GetY() - c.GetY();
-	CPair	alpha = a - b,
-			beta  = d - c;
-	CPair	soln;
+	int n = this->size(), h = 0;
+	this->hull.clear();
+	this->num_axes = 0;
+	this->pad = 0;
+	if ( n == 0 )
+		return;
 
-	//If no intersection (no soln or !(0 <= k <= 1) ), return failure
-	if (	!Solve2by2System( A, B, alpha.GetX(), beta.GetX(), alpha.GetY(), beta.GetY(), &soln )
-		 or (soln.GetX() > 1) or (soln.GetX() < 0) or (soln.GetY() > 1) or (soln.GetY() < 0) )
-		return 0;
+	vector<int> order( n ), hull( 2 * n );
+	double mag = 0;
+	for ( int i = 0; i < n; i ++ )
+	{
+		order[i] = i;
+		mag = max( mag, max( (double)fabs(this->xs[i]), (double)fabs(this->ys[i]) ) );
+	}
+	this->pad = SCoord<T>::Slack() * (1 + mag); // as 'BoxPad'
+	sort( order.begin(), order.end(), [this]( int a, int b )
+		{ return ( this->xs[a] < this->xs[b] or ( this->xs[a] == this->xs[b] and this->ys[a] < this->ys[b] ) ); } );
 
-	//Otherwise, set 'kappa' and 'isect' and return success
-	else
+	for ( int pass = 0; pass < 2; pass ++ )
+	{	// the lower chain left to right, then the upper chain right to left
+		int base = h;
+		for ( int k = 0; k < n; k ++ )
+		{
+			int i = order[ pass == 0 ? k : n - 1 - k ];
+			while ( h >= base + 2 )
+			{
+				int a = hull[h-2], b = hull[h-1];
+				if ( OrientSign( CPairT<T>( this->xs[a], this->ys[a] ), CPairT<T>( this->xs[b], this->ys[b] ),
+								 CPairT<T>( this->xs[i], this->ys[i] ) ) > 0 )
+					break;
+				h --;
+			}
+			hull[h++] = i;
+		}
+		h --; // each chain ends where the other begins
+	}
+	h = max( h, 1 );
+	this->hull.resize( 2 * h );
+	for ( int k = 0; k < h; k ++ )
 	{
-		*kappa = soln.GetX();
-		*isect = a - alpha * (*kappa);
-		return 1;
+		this->hull[k] = this->xs[ hull[k] ];
+		this->hull[h + k] = this->ys[ hull[k] ];
+	}
+
+	const T * hx = this->hull.data(), * hy = hx + h;
+	int num = min( h, HULL_AXES );
+	for ( int a = 0; a < num and h > 1; a ++ )
+	{
+		int i = a * h / num, j = (i + 1) % h;
+		double	dx = (double)hx[j] - hx[i],
+				dy = (double)hy[j] - hy[i],
+				len = sqrt( dx * dx + dy * dy );
+		if ( len == 0 )
+			continue;
+		SAxis & axis = this->axes[ this->num_axes ++ ];
+		axis.nx = dy / len, axis.ny = -dx / len;
+		axis.extent = axis.nx * hx[i] + axis.ny * hy[i] + this->pad;
 	}
 }
 
-struct SIsectData
+template <class T>
+SPtsViewT<T> CObstacleT<T>::Hull(void)
 {
-	float k;
-	CPair pair;
-	SSeg  o_seg;
-};
+	this->BuildIndex();
+	unsigned int h = this->hull.size() / 2;
+	return { this->hull.data(), this->hull.data() + h, h };
+}
 
-bool compare_k( const SIsectData & first, const SIsectData & second )
+template <class T>
+bool CObstacleT<T>::Misses( SSegT<T> seg )
+/* Cheap tests, from the cheapest, for whether 'seg' stays clear of the obstacle:
+ * the bounding box, then the separating axes (both end points beyond the same hull edge),
+ * then the segment's own normal (the whole hull, unless it is large, on one side of its line).
+ * Every test allows a margin for rounding, so a miss is never reported for an edge 'SegIntersect' would hit. */
 {
-	if ( first.k < second.k )
+	if ( !BoxHitsSeg( this->Bounds(), seg ) )
 		return true;
-	else
+
+	double	ax = seg.start.GetX(), ay = seg.start.GetY(),
+			bx = seg.end.GetX(),   by = seg.end.GetY(),
+			pad = max( this->pad, SCoord<T>::Slack() * ( 1 + max( max(fabs(ax), fabs(ay)), max(fabs(bx), fabs(by)) ) ) );
+	double slack = pad - this->pad;
+	bool beyond = false;
+	for ( int a = 0; a < this->num_axes; a ++ )
+	{	// branch-free, like the hull loop below: which way each test goes is anyone's guess
+		SAxis & axis = this->axes[a];
+		beyond |= ( axis.nx * ax + axis.ny * ay > axis.extent + slack )
+				& ( axis.nx * bx + axis.ny * by > axis.extent + slack );
+	}
+	if ( beyond )
+		return true;
+
+	int h = this->hull.size() / 2;
+	if ( h > HULL_TEST_MAX )
 		return false;
+	const T * hx = this->hull.data(), * hy = hx + h;
+	double	dx = bx - ax, dy = by - ay,
+			margin = pad * sqrt( dx * dx + dy * dy );
+	double lo = HUGE_VAL, hi = -HUGE_VAL;
+	for ( int i = 0; i < h; i ++ )
+	{	// no early exit: the hulls are small, and a branch-free loop beats a mispredicted one
+		double side = dx * (hy[i] - ay) - dy * (hx[i] - ax);
+		lo = min( lo, side );
+		hi = max( hi, side );
+	}
+	return ( lo > margin or hi < -margin );
 }
 
-int ObstacleIntersection( SSeg seg, CObstacle * obstacle, list<SIsectData> * isects, float tolerance )
-/* Sets a vector of parameters, CPairs, and segments (of the obstacle) intersected,
- * sorted in order of intersection by the parameter list of 'k's. */
+template <class T>
+CObstacleT<T> CObstacleT<T>::Simplified( double tolerance )
+/* Cuts the outline into runs of edges within 'tolerance' of their chord, and replaces each
+ * by its chord pushed outward until the whole run lies behind it (plus the rounding margin); the new corners
+ * are where neighbouring chords meet. Where that would not cover the obstacle (the outline crosses itself,
+ * or some of the obstacle pokes out), it tries again with half the tolerance, and in the end gives up and
+ * returns a plain copy. Only closed obstacles are simplified; a wall comes back as it is. */
 {
-	int num = 0;
-	{// Get the intersection info
-		SSeg o_seg;
-		float k;
-		CPair isect;
-		bool first = true;
-		CPair oldpt = obstacle->GetPts().front();
-		for ( CPair & pt : obstacle->GetPts() )
-		{
-			if ( first )
+	this->BuildIndex();
+	int n = this->size();
+	if ( n < 5 or this->xs[0] != this->xs[n-1] or this->ys[0] != this->ys[n-1] )
+		return *this;
+
+	double area = 0;
+	for ( int i = 0; i + 1 < n; i ++ )
+		area += (double)this->xs[i] * this->ys[i+1] - (double)this->xs[i+1] * this->ys[i];
+	double	outward = ( area > 0 ? 1 : -1 ),	// the interior lies left of a counterclockwise outline
+			grow = this->pad + ( numeric_limits<T>::is_integer ? 1 : 0 ),
+			limit = SCoord<T>::From(tolerance);
+
+	for ( int attempt = 0; attempt < 4; attempt ++, limit /= 2 )
+	{
+		// Douglas-Peucker: a run is split at its vertex farthest from its chord until that is within 'limit'
+		vector< pair<int,int> > runs, split = { { 0, n - 1 } };
+		while ( !split.empty() )
+		{
+			pair<int,int> run = split.back();
+			split.pop_back();
+			double	ax = this->xs[run.first], ay = this->ys[run.first],
+					sx = this->xs[run.second] - ax, sy = this->ys[run.second] - ay,
+					len2 = sx * sx + sy * sy, far2 = -1;
+			int far = ( run.first + run.second ) / 2;
+			for ( int i = run.first + 1; i < run.second; i ++ )
 			{
-				first = false;
-				continue;
+				double	px = this->xs[i] - ax, py = this->ys[i] - ay,
+						t = ( len2 > 0 ? max( 0.0, min( 1.0, ( px * sx + py * sy ) / len2 ) ) : 0 ),
+						ex = px - t * sx, ey = py - t * sy;
+				if ( ex * ex + ey * ey > far2 )
+					far2 = ex * ex + ey * ey, far = i;
 			}
+			if ( run.second - run.first < 2 or ( len2 > 0 and far2 <= limit * limit ) )
+				runs.push_back(run);
+			else	// the later half first, so that the runs come off in order
+				split.push_back( { far, run.second } ), split.push_back( { run.first, far } );
+		}
+
+		// each run as a line: a point, its direction and outward normal, and how far out to push it
+		vector<double> px, py, ux, uy, nx, ny, shift;
+		for ( pair<int,int> run : runs )
+		{
+			double	ax = this->xs[run.first], ay = this->ys[run.first],
+					dx = this->xs[run.second] - ax, dy = this->ys[run.second] - ay,
+					len = sqrt( dx * dx + dy * dy ),
+					far = 0;
+			if ( len == 0 )
+				continue;
+			double nxj = outward * dy / len, nyj = -outward * dx / len;
+			for ( int i = run.first + 1; i < run.second; i ++ )
+				far = max( far, ( this->xs[i] - ax ) * nxj + ( this->ys[i] - ay ) * nyj );
+			px.push_back(ax), py.push_back(ay), ux.push_back(dx), uy.push_back(dy);
+			nx.push_back(nxj), ny.push_back(nyj), shift.push_back( far + grow );
+		}
+		int m = px.size();
+		if ( m < 3 or m + 1 >= n )
+			return *this;
 
-			{ //The work is done here
-				o_seg = { oldpt, pt };
-				
-				if ( SegIntersect( seg, o_seg, &k, &isect ) and (k >= tolerance and k <= 1 - tolerance) )
-					isects->push_back( { k, isect, o_seg} ), num ++;
+		list< CPairT<T> > pts;
+		for ( int j = 0; j < m; j ++ )
+		{
+			int k = ( j + 1 ) % m;
+			double	ox = px[j] + nx[j] * shift[j], oy = py[j] + ny[j] * shift[j],
+					across = ux[j] * nx[k] + uy[j] * ny[k];
+			if ( fabs(across) < 1e-6 * sqrt( ux[j] * ux[j] + uy[j] * uy[j] ) )
+			{	// (nearly) parallel: step from one line to the other at the shared vertex
+				pts.push_back( CPairT<T>( SCoord<T>::Near( px[k] + nx[j] * shift[j] ), SCoord<T>::Near( py[k] + ny[j] * shift[j] ) ) );
+				pts.push_back( CPairT<T>( SCoord<T>::Near( px[k] + nx[k] * shift[k] ), SCoord<T>::Near( py[k] + ny[k] * shift[k] ) ) );
+				continue;
 			}
-			oldpt = pt;
+			double t = ( shift[k] - ( ( ox - px[k] ) * nx[k] + ( oy - py[k] ) * ny[k] ) ) / across;
+			pts.push_back( CPairT<T>( SCoord<T>::Near( ox + t * ux[j] ), SCoord<T>::Near( oy + t * uy[j] ) ) );
 		}
+		pts.push_front( pts.back() );	// the corner between the last run and the first starts the outline
+		pts.pop_back();
+		pts.push_back( pts.front() );
+		CObstacleT<T> coarse( &pts );
+		SPtsViewT<T> c = coarse.Pts();
+		int edges = c.n - 1;
+
+		auto Crosses = [&]( CPairT<T> p, CPairT<T> q, int skip )
+		{	// whether 'p'-'q' properly crosses an edge of the coarse outline (other than 'skip' and its neighbours)
+			vector<int> hits;
+			coarse.EdgeCandidates( SSegT<T>{ p, q }, &hits );
+			for ( int e : hits )
+			{
+				if ( skip >= 0 and ( e == skip or e == (skip + 1) % edges or skip == (e + 1) % edges ) )
+					continue;
+				CPairT<T> a( c.x[e], c.y[e] ), b( c.x[e+1], c.y[e+1] );
+				if ( OrientSign( p, q, a ) * OrientSign( p, q, b ) < 0 and OrientSign( a, b, p ) * OrientSign( a, b, q ) < 0 )
+					return true;
+			}
+			return false;
+		};
+		auto Covers = [&]( CPairT<T> p )
+		{	// whether 'p' lies inside the coarse outline or on it (counting crossings of a ray to the right)
+			vector<int> hits;
+			CPairT<T> beyond( coarse.Bounds().xmax + ( coarse.Bounds().xmax - p.GetX() ) + 1, p.GetY() );
+			coarse.EdgeCandidates( SSegT<T>{ p, beyond }, &hits );
+			bool inside = false;
+			for ( int e : hits )
+			{
+				CPairT<T> a( c.x[e], c.y[e] ), b( c.x[e+1], c.y[e+1] );
+				if ( OrientSign( a, b, p ) == 0 and p.GetX() >= min( a.GetX(), b.GetX() ) and p.GetX() <= max( a.GetX(), b.GetX() )
+					 and p.GetY() >= min( a.GetY(), b.GetY() ) and p.GetY() <= max( a.GetY(), b.GetY() ) )
+					return true;
+				if ( ( a.GetY() > p.GetY() ) != ( b.GetY() > p.GetY() )
+					 and OrientSign( a, b, p ) * ( b.GetY() > a.GetY() ? 1 : -1 ) > 0 )
+					inside = !inside;
+			}
+			return inside;
+		};
+
+		bool covers = true;
+		for ( int e = 0; e < edges and covers; e ++ )
+			covers = !Crosses( CPairT<T>( c.x[e], c.y[e] ), CPairT<T>( c.x[e+1], c.y[e+1] ), e );
+		for ( int i = 0; i + 1 < n and covers; i ++ )
+			covers = Covers( CPairT<T>( this->xs[i], this->ys[i] ) )
+					 and !Crosses( CPairT<T>( this->xs[i], this->ys[i] ), CPairT<T>( this->xs[i+1], this->ys[i+1] ), -1 );
+		if ( covers )
+			return coarse;
 	}
-	// If there aren't multiple intersections, no sorting is needed!
-	if ( isects->size() < 2 )	
-		return 0;
-	//Arrange info by k-value
-	isects->sort(compare_k);
+	return *this;
+}
 
-	return num;
+template <class T>
+list< CObstacleT<T> > Simplify( list< CObstacleT<T> > * obstacles, double tolerance )
+{
+	list< CObstacleT<T> > simplified;
+	for ( CObstacleT<T> & obstacle : *obstacles )
+		simplified.push_back( obstacle.Simplified(tolerance) );
+	return simplified;
 }
 
-list<CPair> Circumvent( SSeg seg, CObstacle * obstacle, bool clockwise )
-/* Given a segment 'seg' to describe entry and exit points on 'obstacle',
- * and given a direction of travel by 'clockwise',
- * this function returns a path along 'obstacle'. */
+/// Instrumentation ////////////////////////////////////////////////
+
+thread_local SQueryStats * query_stats = 0;
+static atomic<CStatsLog *> stats_log( (CStatsLog *)0 );
+
+void SQueryStats::Add( SQueryStats * other )
 {
-	// make the obstacle start and end with 'seg.start'
-	list<CPair> first, second;
-	obstacle->Split(seg.start, &first, &second);
-	CObstacle 	obs = CObstacle(&second) + CObstacle(&first);
-#if DEBUGGING
-	obs.Print();
-#endif
-	// set the direction to go by inverting the list if necessary
-	if ( clockwise == false )
-		obs.Reverse();
+	this->seg_tests += other->seg_tests;
+	this->findpath_calls += other->findpath_calls;
+	this->memo_hits += other->memo_hits;
+	this->obstacles_tested += other->obstacles_tested;
+	this->branches += other->branches;
+	this->max_depth = max( this->max_depth, other->max_depth );
+	this->shortcut_tries += other->shortcut_tries;
+	this->shortcut_takes += other->shortcut_takes;
+	this->arena_chunks += other->arena_chunks;
+	this->arena_bytes += other->arena_bytes;
+	this->tiles_loaded += other->tiles_loaded;
+	this->findpath_us += other->findpath_us;
+	this->optimize_us += other->optimize_us;
+	this->visibility_us += other->visibility_us;
+	this->total_us += other->total_us;
+}
 
-	// split at the exit point 'seg.end'
-	obs.Split(seg.end, &first, &second);
+string SQueryStats::JSON( bool query )
+/* The counts and times as a JSON object, led by the query's end points if 'query'. */
+{
+	char text[1024], ends[128] = "";
+	if ( query )
+		snprintf( ends, sizeof(ends), "\"start\": [%g, %g], \"end\": [%g, %g], ",
+				  this->start[0], this->start[1], this->end[0], this->end[1] );
+	snprintf( text, sizeof(text), "{%s\"seg_tests\": %lu, "
+			  "\"findpath_calls\": %lu, \"memo_hits\": %lu, \"obstacles_tested\": %lu, \"branches\": %lu, "
+			  "\"max_depth\": %u, \"shortcut_tries\": %lu, \"shortcut_takes\": %lu, "
+			  "\"arena_chunks\": %lu, \"arena_bytes\": %lu, \"tiles_loaded\": %lu, \"findpath_us\": %.3f, \"optimize_us\": %.3f, "
+			  "\"visibility_us\": %.3f, \"total_us\": %.3f}",
+			  ends, this->seg_tests,
+			  this->findpath_calls, this->memo_hits, this->obstacles_tested, this->branches,
+			  this->max_depth, this->shortcut_tries, this->shortcut_takes,
+			  this->arena_chunks, this->arena_bytes, this->tiles_loaded, this->findpath_us, this->optimize_us,
+			  this->visibility_us, this->total_us );
+	return text;
+}
 
-	// return the route from entry to exit
-	return first;
+CStatsLog::CStatsLog()
+{
+	this->Reset();
 }
 
-float SegLen( CPair start, CPair end )
+void CStatsLog::Record( SQueryStats * stats )
 {
-	CPair v = end - start;
-	float len = sqrt(v * v);
-	return len;
+	lock_guard<mutex> hold(this->lock);
+	if ( this->queries.size() < STATS_QUERIES_MAX )
+		this->queries.push_back(*stats);
+	this->total.Add(stats);
+	this->count ++;
 }
 
-float PathLen( list<CPair> * ptlist )
+void CStatsLog::Reset(void)
 {
-	float length = 0;
-	bool first = true;
-	CPair oldpt = ptlist->front();
-	for ( CPair & pt : *ptlist )
-	{
-		if ( first )
-		{
-			first = false;
-			continue;
-		}
+	lock_guard<mutex> hold(this->lock);
+	this->queries.clear();
+	memset( &this->total, 0, sizeof(this->total) );
+	this->count = 0;
+}
 
-		length += SegLen( oldpt, pt );
+unsigned long CStatsLog::size(void)
+{
+	lock_guard<mutex> hold(this->lock);
+	return this->count;
+}
 
-		oldpt = pt;
+string CStatsLog::JSON( bool per_query )
+/* {"queries": <count>, "total": {...}, "per_query": [{...}, ...]} (the last only if 'per_query').
+ * The totals add up every field but 'max_depth', which is the deepest of any query. */
+{
+	lock_guard<mutex> hold(this->lock);
+	string text = "{\"queries\": " + to_string(this->count) + ", \"total\": " + this->total.JSON(false);
+	if ( per_query )
+	{
+		text += ", \"per_query\": [";
+		for ( unsigned int i = 0; i < this->queries.size(); i ++ )
+			text += ( i ? ",\n  " : "\n  " ) + this->queries[i].JSON(true);
+		text += "]";
 	}
-	return length;
+	return text + "}";
 }
 
-list<CPair> minCircumvent( SSeg seg, CObstacle * obstacle )
-/* Just like 'Circumvent', only this function computes clockwise and cclockwise paths,
- * returning the shorter of the two. */
+void EnableStats( CStatsLog * log )
 {
-	list<CPair> 	path1 = Circumvent( seg, obstacle, true ),
-					path2 = Circumvent( seg, obstacle, false );
+	stats_log.store(log);
+}
 
-	float 	len1 = PathLen(&path1),
-			len2 = PathLen(&path2);
-	cout << len1 << ", " << len2 << endl;
+double StatsMicros(void)
+{
+	return chrono::duration<double, micro>( chrono::steady_clock::now().time_since_epoch() ).count();
+}
 
-	if (len1 < len2)
-		return path1;
-	else
-		return path2;
+template <class T>
+CStatsScope::CStatsScope( SSegT<T> seg )
+{
+	this->log = ( query_stats ? 0 : stats_log.load() );
+	if ( !this->log )
+		return;
+	memset( &this->stats, 0, sizeof(this->stats) );
+	this->stats.start[0] = SCoord<T>::Value( seg.start.GetX() ), this->stats.start[1] = SCoord<T>::Value( seg.start.GetY() );
+	this->stats.end[0] = SCoord<T>::Value( seg.end.GetX() ), this->stats.end[1] = SCoord<T>::Value( seg.end.GetY() );
+	query_stats = &this->stats;
+	this->started = StatsMicros();
 }
 
-list<CPair> FindPath( SSeg seg, list<CObstacle> * obstacles, float tolerance )
+CStatsScope::~CStatsScope()
 {
-	list<CObstacle> o_list = *obstacles;
+	if ( !this->log )
+		return;
+	this->stats.total_us = StatsMicros() - this->started;
+	query_stats = 0;
+	this->log->Record(&this->stats);
+}
 
-	// Stop recurring if there are no more obstacles
-	if ( o_list.size() < 1 )
-	{
-#if DEBUGGING
-		cout << "no more obstacles" << endl;							//DEBUG LINE
-#endif
-		return {seg.start, seg.end};
-	}
-#if DEBUGGING
-	else {cout << o_list.size() << " obstacle(s) remain(s)" << endl;}												//DEBUG LINE
-#endif
-	// Deal with the next obstacle
-	CObstacle obstacle = o_list.front();
-	list<SIsectData> isects;// replaces the previous three data lists
-#if DEBUGGING
-	cout << "active obstacle is ";										//DEBUG LINE
-	obstacle.Print();													//DEBUG LINE
-#endif
+/// Query arenas ////////////////////////////////////////////////////
 
-	if ( !ObstacleIntersection( seg, &obstacle, &isects, tolerance ) )
-	// if obstacle is not in the way
-	{
-		o_list.erase(o_list.begin());
-#if DEBUGGING
-		cout << "No intersection with obstacle " << &obstacle << endl;	//DEBUG LINE
-#endif
-		return FindPath( seg, &o_list, tolerance );
-	}
+CArena::CArena()
+{
+	this->used = this->capacity = this->held = 0;
+	this->next_size = ARENA_CHUNK;
+}
 
-	// else, we have a naive path to be broken down (for now, we ignore any intermediate intersections as irrelevant):
-	//	seg.start, isect[0], ... , isect[n], seg.end
-	// we assume the last intersection is the exit point. Bad things happen/get ignored if the destination is inside an obstacle.
-	CPair 	i_pt_in  = isects.front().pair,
-			i_pt_out = isects.back().pair; 
-	SSeg 	o_seg_in  = isects.front().o_seg,
-			o_seg_out = isects.back().o_seg;
-	bool orientation;
+CArena::~CArena()
+{
+	for ( char * chunk : this->chunks )
+		delete [] chunk;
+}
 
-	i_pt_out.SetOnObstacle(true);
+void * CArena::Grow( size_t bytes )
+/* Starts a new chunk (big enough for 'bytes') and allocates from it. */
+{
+	size_t size = max( this->next_size, bytes );
+	this->chunks.push_back( new char[size] );
+	if ( query_stats )
+		query_stats->arena_chunks ++;
+	this->used = bytes;
+	this->capacity = size;
+	this->held += size;
+	this->next_size = min( 2 * this->next_size, (size_t)ARENA_CHUNK_MAX );
+	return this->chunks.back();
+}
 
-	// Now, navigate around the obstacle
-	list<CPair> path1 = Circumvent( {o_seg_in.end, o_seg_out.start}, &obstacle, RIGHT );
-	orientation = path1.begin()->GetSide();
-	i_pt_in.SetSide(orientation);
-	i_pt_out.SetSide(orientation);
-#if DEBUGGING
-	cout << "intersections with obstacle are " << i_pt_in.SPrint() << "and" << i_pt_out.SPrint() << endl;
-	cout << "path1 orientation has been set to " << ( path1.begin()->GetSide() ? 'L' : 'R' ) << endl;
-#endif
-	path1.push_front(i_pt_in);
-	path1.push_back(i_pt_out);
+void CArena::Release(void)
+/* Frees everything allocated so far; all pointers into the arena become invalid. */
+{
+	if ( this->chunks.empty() )
+		return;
+	for ( unsigned int i = 0; i + 1 < this->chunks.size(); i ++ )
+		delete [] this->chunks[i];
+	this->chunks.erase( this->chunks.begin(), this->chunks.end() - 1 );
+	this->used = 0;
+	this->held = this->capacity;
+}
 
-	list<CPair> path2 = Circumvent( {o_seg_in.start, o_seg_out.end}, &obstacle, LEFT );
-	orientation = path2.begin()->GetSide();
-	i_pt_in.SetSide(orientation);
-	i_pt_out.SetSide(orientation);
-#if DEBUGGING
-	cout << "path2 orientation has been set to " << ( path2.begin()->GetSide() ? 'L' : 'R' ) << endl;
-#endif
-	path2.push_front(i_pt_in);
-	path2.push_back(i_pt_out);
+size_t CArena::Capacity(void)
+{
+	return this->held;
+}
 
-	//Choose the path with minimal length
-	float 	len1 = PathLen(&path1),
-			len2 = PathLen(&path2);
-	list<CPair> path;
-	path = { (len1 < len2) ? path1 : path2 };
-#if DEBUGGING
-	cout << len1 << ", " << len2 << endl;								//DEBUG LINE
-	if (len1 < len2)
-		cout << "chose path1 for its local efficiency:";				//DEBUG LINE
+//Non-member functions ///////////////////////////////////////////////////////////////////
+
+template <class T>
+bool Solve2by2System( T A, T B, T a, T b, T c, T d, CPairT<T> * soln )
+/* Solves
+ * A = ax + by
+ * B = cx + dy
+ * and returns the pair (x,y) */
+{
+	T denom = b * c - a * d;
+	
+	if ( denom == 0 )
+		return 0;
 	else
-		cout << "chose path2 for its local efficiency:";				//DEBUG LINE
-	cout << endl;														//DEBUG LINE
-	PrintPath(&path);
-#endif
-	// Figure out the rest of the path (looking for ways around the other obstacles) ...
-	o_list.erase(o_list.begin());
-#if DEBUGGING
-	cout << o_list.size() << endl;										//DEBUG LINE
-	cout << "Moving to next of " << o_list.size() << " obstacles" << endl;//DEBUG LINE
-	cout << "in-vector is ";
-	PrintSeg({seg.start, i_pt_in});										//DEBUG LINE
-	cout << "out-vector is ";
-	PrintSeg({i_pt_out,  seg.end});										//DEBUG LINE
-#endif
-	//.. by splitting the path and recurring to remaining obstacles
-	list<CPair> prepath  = FindPath( {seg.start, i_pt_in}, &o_list, tolerance );
-	list<CPair> postpath = FindPath( {i_pt_out,  seg.end}, &o_list, tolerance );
+	{
+		*soln = CPairT<T>( (b*B-d*A)/denom, (c*A-a*B)/denom );
+		return 1;
+	}
+}
 
-	prepath.pop_back();  //important: unique gets rid of the wrong pts
-	postpath.pop_front();//important: unique gets rid of the wrong pts
-	list<CPair> route = ConcatPaths( {&prepath, &path, &postpath} );
-	route.unique();
-	return route;
+/* The intersection tests first decide in floating point, as they always have, and only fall back on exact predicates
+ * when a rounding error could have changed the outcome: when the segments are nearly parallel,
+ * or the crossing lies within rounding distance of an end of either segment.
+ * Each term is a product of two rounded differences and then a sum, so its relative error
+ * stays well under 'SCoord<T>::Doubt()' (sixteen ulps: 2^-20 for float, 2^-49 for double).
+ * Fixed-point coordinates are always decided exactly, in 64-bit integers. */
+#define ORIENT_ERRBOUND	3.3306690738754716e-16	// (3 + 16e) e, with e = 2^-53: Shewchuk's bound for 'Orient' in double
+
+int ExactSign( const double * terms, int n )
+/* The sign of the exact sum of the 'n' (at most 16) 'terms', kept as a nonoverlapping expansion
+ * (Shewchuk's Grow-Expansion with zero elimination), whose largest component has the sign of the whole. */
+{
+	double expansion[16];
+	int m = 0;
+	for ( int t = 0; t < n; t ++ )
+	{
+		double q = terms[t];
+		int kept = 0;
+		for ( int i = 0; i < m; i ++ )
+		{
+			double	sum = q + expansion[i],
+					bv = sum - q,
+					av = sum - bv,
+					err = ( q - av ) + ( expansion[i] - bv );
+			q = sum;
+			if ( err != 0 )
+				expansion[kept ++] = err;
+		}
+		if ( q != 0 )
+			expansion[kept ++] = q;
+		m = kept;
+	}
+	return ( m == 0 ? 0 : ( expansion[m-1] > 0 ? 1 : -1 ) );
 }
 
-list<CPair> FindPath( SSeg seg, list<CObstacle> * obstacles)
+template <class T>
+int OrientExact( double ax, double ay, double bx, double by, double cx, double cy )
+/* The exact sign of the determinant of 'Orient', summed from its six products of coordinates,
+ * each split by 'fma' into the double nearest it and the rounding error. */
 {
-	return FindPath( seg, obstacles, 0 );
+	double	factors[6][2] = { { bx, cy }, { -bx, ay }, { -ax, cy }, { -by, cx }, { by, ax }, { ay, cx } },
+			terms[12];
+	for ( int i = 0; i < 6; i ++ )
+	{
+		terms[2*i] = factors[i][0] * factors[i][1];
+		terms[2*i + 1] = fma( factors[i][0], factors[i][1], -terms[2*i] );
+	}
+	return ExactSign( terms, 12 );
 }
 
-bool OptimizePath( list<CPair> * sequence, list<CObstacle> * obstacles, float tolerance )
+template <>
+int OrientExact<float>( double ax, double ay, double bx, double by, double cx, double cy )
+/* A double holds the product of two floats exactly. */
 {
-	bool path_not_shortened;
-	list<CPair>::iterator pt = sequence->begin(), candidate, anchor;
-	advance( pt, 2 );
-#if DEBUGGING
-	cout << "Optimizing---------------" << endl;						//DEBUG LINE
+	double terms[6] = { bx * cy, -bx * ay, -ax * cy, -by * cx, by * ax, ay * cx };
+	return ExactSign( terms, 6 );
+}
+
+template <class T>
+int OrientSign( CPairT<T> a, CPairT<T> b, CPairT<T> c )
+/* 'Orient' in double is right unless it comes out within its error bound of zero. Then the determinant
+ * is summed exactly by 'OrientExact'. */
+{
+	double	left  = ( (double)b.GetX() - a.GetX() ) * ( (double)c.GetY() - a.GetY() ),
+			right = ( (double)b.GetY() - a.GetY() ) * ( (double)c.GetX() - a.GetX() ),
+			det = left - right,
+			bound = ORIENT_ERRBOUND * ( fabs(left) + fabs(right) );
+	if ( det > bound )
+		return 1;
+	if ( -det > bound )
+		return -1;
+
+	double	ax = a.GetX(), ay = a.GetY(), bx = b.GetX(), by = b.GetY(), cx = c.GetX(), cy = c.GetY();
+	if ( ( ax == cx and ay == cy ) or ( bx == cx and by == cy ) or ( ax == bx and ay == by ) )
+		return 0; // the usual case here: a route leaving from a vertex of the edge it is tested against
+	return OrientExact<T>( ax, ay, bx, by, cx, cy );
+}
+
+template <>
+int OrientSign( CPairT<int> a, CPairT<int> b, CPairT<int> c )
+/* Fixed point: with the coordinates less than 2^30 from zero, the differences are below 2^31,
+ * each product below 2^62, and so the determinant is exact in 64 bits. */
+{
+	long long det = ( (long long)b.GetX() - a.GetX() ) * ( (long long)c.GetY() - a.GetY() )
+				  - ( (long long)b.GetY() - a.GetY() ) * ( (long long)c.GetX() - a.GetX() );
+	return ( det > 0 ) - ( det < 0 );
+}
+
+template <class T>
+bool SegIntersectExact( typename SSegArg<T>::type seg1, typename SSegArg<T>::type seg2, typename SCoord<T>::real * kappa, CPairT<T> * isect )
+/* As 'SegIntersect': touching counts, parallel (or collinear) segments never intersect.
+ * When the crossing is exactly at a vertex, 'isect' is that vertex, so it can be found again with '=='. */
+{
+	CPairT<T>	a = seg1.start, b = seg1.end, c = seg2.start, d = seg2.end;
+	int		oa = OrientSign( c, d, a ), ob = OrientSign( c, d, b ),
+			oc = OrientSign( a, b, c ), od = OrientSign( a, b, d );
+	if ( oa * ob > 0 or oc * od > 0 or ( oa == 0 and ob == 0 ) or ( oc == 0 and od == 0 ) )
+		return 0;
+
+	double	da = Orient( c, d, a ), db = Orient( c, d, b ),
+			k = ( da == db ? 0 : da / ( da - db ) );
+	k = min( 1.0, max( 0.0, k ) );
+	if ( oa == 0 )
+		*kappa = 0, *isect = a;
+	else if ( ob == 0 )
+		*kappa = 1, *isect = b;
+	else
+	{
+		*kappa = k;
+		if ( oc == 0 )
+			*isect = c;
+		else if ( od == 0 )
+			*isect = d;
+		else
+			*isect = CPairT<T>( SCoord<T>::Near( a.GetX() + k * ( (double)b.GetX() - a.GetX() ) ),
+								SCoord<T>::Near( a.GetY() + k * ( (double)b.GetY() - a.GetY() ) ) );
+	}
+	return 1;
+}
+
+template <class T>
+bool SegInDoubt( typename SCoord<T>::real A, typename SCoord<T>::real B, typename SCoord<T>::real alx, typename SCoord<T>::real aly,
+				 typename SCoord<T>::real bx, typename SCoord<T>::real by, bool shared )
+/* Whether rounding may have decided the floating-point test of 'SegIntersect' (with the terms named as there) wrongly.
+ * A term whose products all come out zero is exactly zero, as when 'seg1' starts where 'seg2' does.
+ * If 'seg1' starts where 'seg2' ends, or ends where it starts ('shared'), only the denominator can be in doubt. */
+{
+	typedef typename SCoord<T>::real real;
+	real	denom = bx * aly - alx * by,
+			num_k = bx * B - by * A,
+			num_mu = aly * A - alx * B,
+			scale_d = fabs(bx * aly) + fabs(alx * by),
+			scale_k = fabs(bx * B) + fabs(by * A),
+			scale_mu = fabs(aly * A) + fabs(alx * B),
+			bound = SCoord<T>::Doubt();
+	if ( fabs(denom) < bound * scale_d )
+		return true;
+	return ( !shared
+			 and (	fabs(num_k) < bound * scale_k or fabs(denom - num_k) < bound * ( scale_d + scale_k )
+				 or fabs(num_mu) < bound * scale_mu or fabs(denom - num_mu) < bound * ( scale_d + scale_mu ) ) );
+}
+
+template <>
+bool SegInDoubt<int>( double A, double B, double alx, double aly, double bx, double by, bool shared )
+/* Fixed point is always settled exactly: its integer predicates cost next to nothing more. */
+{
+	return true;
+}
+
+template <class T>
+bool SegIntersect( CPairT<T> seg1start, CPairT<T> seg1end, CPairT<T> seg2start, CPairT<T> seg2end, typename SCoord<T>::real * kappa, CPairT<T> * isect )
+/* If an intersection DOES exist:
+ * 		we return success,
+ * 		set 'isect' as the point of intersection,
+ * 		and set 'kappa' to indicate how far along the first segment the intersection lies.
+ * 		( we have 0 <= k <= 1 if an intersection exists )
+ * If an intersection does NOT exist:
+ * 		return failure,
+ * 		do not set 'kappa'. */
+{
+	return SegIntersect( SSegT<T>{ seg1start, seg1end }, SSegT<T>{ seg2start, seg2end }, kappa, isect );
+}
+
+template <class T>
+bool SegIntersect( SSegT<T> seg1, SSegT<T> seg2, typename SCoord<T>::real * kappa, CPairT<T> * isect )
+/* If an intersection DOES exist:
+ * 		we return success,
+ * 		set 'isect' as the point of intersection,
+ * 		and set 'kappa' to indicate how far along the first segment the intersection lies.
+ * 		( we have 0 <= k <= 1 if an intersection exists )
+ * If an intersection does NOT exist:
+ * 		return failure,
+ * 		do not set 'kappa. */
+{
+	typedef typename SCoord<T>::real real;
+	if ( query_stats )
+		query_stats->seg_tests ++;	// here and in the block kernels, which every edge test goes through
+	CPairT<T>	a = seg1.start,
+				b = seg1.end,
+				c = seg2.start,
+				d = seg2.end;
+	real	A = (real)a.GetX() - c.GetX(),
+			B = (real)a.GetY() - c.GetY();
+	CPairT<T>	alpha = a - b,
+				beta  = d - c;
+	CPairT<real>	soln;
+
+	//Settle it exactly if rounding may get it wrong
+	if ( SegInDoubt<T>( A, B, alpha.GetX(), alpha.GetY(), beta.GetX(), beta.GetY(), a == d or b == c ) )
+		return SegIntersectExact<T>( {a, b}, {c, d}, kappa, isect );
+
+	//If no intersection (no soln or !(0 <= k <= 1) ), return failure
+	if (	!Solve2by2System<real>( A, B, alpha.GetX(), beta.GetX(), alpha.GetY(), beta.GetY(), &soln )
+		 or (soln.GetX() > 1) or (soln.GetX() < 0) or (soln.GetY() > 1) or (soln.GetY() < 0) )
+		return 0;
+
+	//Otherwise, set 'kappa' and 'isect' and return success
+	else
+	{
+		*kappa = soln.GetX();
+		*isect = ( b == c ? b : a - alpha * (*kappa) );
+		return 1;
+	}
+}
+
+template <class T>
+unsigned int SegIntersectBlock( SSegT<T> seg, const T * x, const T * y, int n, typename SCoord<T>::real * kappa, T * ix, T * iy )
+/* Tests 'seg' against the 'n' (at most EDGE_BLOCK) consecutive edges from (x[i],y[i]) to (x[i+1],y[i+1]),
+ * with the very same arithmetic as 'SegIntersect'. This is the scalar kernel, for the coordinate types
+ * without a SIMD one: each edge is either decided by the floating-point test or, if that is in doubt, exactly.
+ * Returns a mask with bit 'i' set if edge 'i' is crossed, in which case
+ * 'kappa[i]' tells how far along 'seg' and (ix[i],iy[i]) is the point of intersection. */
+{
+	typedef typename SCoord<T>::real real;
+	real	ax = seg.start.GetX(), ay = seg.start.GetY(),
+			alx = ax - seg.end.GetX(), aly = ay - seg.end.GetY();
+	unsigned int mask = 0;
+	if ( query_stats )
+		query_stats->seg_tests += n;
+	for ( int i = 0; i < n; i ++ )
+	{
+		real	cx = x[i], cy = y[i],
+				bx = x[i+1] - cx, by = y[i+1] - cy,
+				A  = ax - cx, B = ay - cy,
+				denom = bx * aly - alx * by;
+		bool	ends_at = ( x[i] == seg.end.GetX() and y[i] == seg.end.GetY() ),
+				shared = ( ends_at or ( x[i+1] == seg.start.GetX() and y[i+1] == seg.start.GetY() ) );
+		if ( SegInDoubt<T>( A, B, alx, aly, bx, by, shared ) )
+		{
+			CPairT<T> pt;
+			if ( SegIntersectExact<T>( seg, { CPairT<T>( x[i], y[i] ), CPairT<T>( x[i+1], y[i+1] ) }, kappa + i, &pt ) )
+			{
+				ix[i] = pt.GetX(), iy[i] = pt.GetY();
+				mask |= 1u << i;
+			}
+			continue;
+		}
+		real	k  = ( bx * B - by * A ) / denom,
+				mu = ( aly * A - alx * B ) / denom;
+		if ( (k > 1) or (k < 0) or (mu > 1) or (mu < 0) )
+			continue;
+		kappa[i] = k;
+		ix[i] = ( ends_at ? seg.end.GetX() : SCoord<T>::Near( ax - k * alx ) );
+		iy[i] = ( ends_at ? seg.end.GetY() : SCoord<T>::Near( ay - k * aly ) );
+		mask |= 1u << i;
+	}
+	return mask;
+}
+
+template <>
+unsigned int SegIntersectBlock( SSeg seg, const float * x, const float * y, int n, float * kappa, float * ix, float * iy )
+/* The float kernel: the very same arithmetic as 'SegIntersect', but 8 edges per instruction with AVX2 (4 with SSE2).
+ * The edges left in doubt are then settled one by one by 'SegIntersectExact'. An edge that ends where 'seg'
+ * starts, or starts where it ends, is not in doubt unless it is nearly parallel: the float terms then
+ * cancel exactly, and the point of intersection is the shared end.
+ * Returns a mask with bit 'i' set if edge 'i' is crossed, in which case
+ * 'kappa[i]' tells how far along 'seg' and (ix[i],iy[i]) is the point of intersection. */
+{
+	float	ax = seg.start.GetX(), ay = seg.start.GetY(),
+			bsx = seg.end.GetX(), bsy = seg.end.GetY(),
+			alx = ax - bsx, aly = ay - bsy;
+	unsigned int mask = 0, doubt = 0;
+	if ( query_stats )
+		query_stats->seg_tests += n;
+	int i = 0;
+#if defined(__AVX2__)
+	{
+		__m256	vax = _mm256_set1_ps(ax), vay = _mm256_set1_ps(ay),
+				vbx = _mm256_set1_ps(bsx), vby = _mm256_set1_ps(bsy),
+				valx = _mm256_set1_ps(alx), valy = _mm256_set1_ps(aly),
+				zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1),
+				sign = _mm256_set1_ps(-0.0f), bound = _mm256_set1_ps( SCoord<float>::Doubt() );
+		for ( ; i + 8 <= n; i += 8 )
+		{
+			__m256	cx = _mm256_loadu_ps(x + i),	cy = _mm256_loadu_ps(y + i),
+					dx = _mm256_loadu_ps(x + i + 1),	dy = _mm256_loadu_ps(y + i + 1),
+					bx = _mm256_sub_ps(dx, cx),		by = _mm256_sub_ps(dy, cy),
+					A  = _mm256_sub_ps( vax, cx ),	B  = _mm256_sub_ps( vay, cy ),
+					d1 = _mm256_mul_ps(bx, valy),	d2 = _mm256_mul_ps(valx, by),
+					k1 = _mm256_mul_ps(bx, B),		k2 = _mm256_mul_ps(by, A),
+					m1 = _mm256_mul_ps(valy, A),	m2 = _mm256_mul_ps(valx, B),
+					denom = _mm256_sub_ps(d1, d2), num_k = _mm256_sub_ps(k1, k2), num_mu = _mm256_sub_ps(m1, m2),
+					k  = _mm256_div_ps( num_k, denom ),
+					mu = _mm256_div_ps( num_mu, denom ),
+					miss = _mm256_or_ps(
+							_mm256_or_ps( _mm256_cmp_ps(denom, zero, _CMP_EQ_OQ), _mm256_cmp_ps(k, one, _CMP_GT_OQ) ),
+							_mm256_or_ps( _mm256_or_ps( _mm256_cmp_ps(k, zero, _CMP_LT_OQ), _mm256_cmp_ps(mu, one, _CMP_GT_OQ) ),
+										  _mm256_cmp_ps(mu, zero, _CMP_LT_OQ) ) ),
+					// the error bounds of 'SegInDoubt'
+					scale_d  = _mm256_mul_ps( bound, _mm256_add_ps( _mm256_andnot_ps(sign, d1), _mm256_andnot_ps(sign, d2) ) ),
+					scale_k  = _mm256_mul_ps( bound, _mm256_add_ps( _mm256_andnot_ps(sign, k1), _mm256_andnot_ps(sign, k2) ) ),
+					scale_mu = _mm256_mul_ps( bound, _mm256_add_ps( _mm256_andnot_ps(sign, m1), _mm256_andnot_ps(sign, m2) ) ),
+					unsure = _mm256_or_ps(
+							_mm256_or_ps( _mm256_cmp_ps( _mm256_andnot_ps(sign, num_k), scale_k, _CMP_LT_OQ ),
+										  _mm256_cmp_ps( _mm256_andnot_ps(sign, num_mu), scale_mu, _CMP_LT_OQ ) ),
+							_mm256_or_ps( _mm256_cmp_ps( _mm256_andnot_ps( sign, _mm256_sub_ps(denom, num_k) ),
+														 _mm256_add_ps(scale_d, scale_k), _CMP_LT_OQ ),
+										  _mm256_cmp_ps( _mm256_andnot_ps( sign, _mm256_sub_ps(denom, num_mu) ),
+														 _mm256_add_ps(scale_d, scale_mu), _CMP_LT_OQ ) ) ),
+					ends_at = _mm256_and_ps( _mm256_cmp_ps(cx, vbx, _CMP_EQ_OQ), _mm256_cmp_ps(cy, vby, _CMP_EQ_OQ) ),
+					shared = _mm256_or_ps( ends_at,
+							_mm256_and_ps( _mm256_cmp_ps(dx, vax, _CMP_EQ_OQ), _mm256_cmp_ps(dy, vay, _CMP_EQ_OQ) ) );
+			unsure = _mm256_or_ps( _mm256_cmp_ps( _mm256_andnot_ps(sign, denom), scale_d, _CMP_LT_OQ ),
+								   _mm256_andnot_ps(shared, unsure) );
+			_mm256_storeu_ps( kappa + i, k );
+			_mm256_storeu_ps( ix + i, _mm256_blendv_ps( _mm256_sub_ps( vax, _mm256_mul_ps(k, valx) ), vbx, ends_at ) );
+			_mm256_storeu_ps( iy + i, _mm256_blendv_ps( _mm256_sub_ps( vay, _mm256_mul_ps(k, valy) ), vby, ends_at ) );
+			mask |= ( ~_mm256_movemask_ps(miss) & 0xff ) << i;
+			doubt |= _mm256_movemask_ps(unsure) << i;
+		}
+	}
 #endif
-	while ( pt != sequence->end() )
+#if defined(__SSE2__)
 	{
-		// set a flag to say when to move on (default is 'move on')
-		path_not_shortened = true;
-		
-		// set ref to candidate, the point to be possibly deleted
-		candidate = --pt; 
-		++pt;
-		if ( candidate == sequence->begin() )
+		__m128	vax = _mm_set1_ps(ax), vay = _mm_set1_ps(ay),
+				vbx = _mm_set1_ps(bsx), vby = _mm_set1_ps(bsy),
+				valx = _mm_set1_ps(alx), valy = _mm_set1_ps(aly),
+				zero = _mm_setzero_ps(), one = _mm_set1_ps(1),
+				sign = _mm_set1_ps(-0.0f), bound = _mm_set1_ps( SCoord<float>::Doubt() );
+		for ( ; i + 4 <= n; i += 4 )
 		{
-			++pt;
+			__m128	cx = _mm_loadu_ps(x + i),	cy = _mm_loadu_ps(y + i),
+					dx = _mm_loadu_ps(x + i + 1),	dy = _mm_loadu_ps(y + i + 1),
+					bx = _mm_sub_ps(dx, cx),	by = _mm_sub_ps(dy, cy),
+					A  = _mm_sub_ps( vax, cx ),	B  = _mm_sub_ps( vay, cy ),
+					d1 = _mm_mul_ps(bx, valy),	d2 = _mm_mul_ps(valx, by),
+					k1 = _mm_mul_ps(bx, B),		k2 = _mm_mul_ps(by, A),
+					m1 = _mm_mul_ps(valy, A),	m2 = _mm_mul_ps(valx, B),
+					denom = _mm_sub_ps(d1, d2), num_k = _mm_sub_ps(k1, k2), num_mu = _mm_sub_ps(m1, m2),
+					k  = _mm_div_ps( num_k, denom ),
+					mu = _mm_div_ps( num_mu, denom ),
+					miss = _mm_or_ps(
+							_mm_or_ps( _mm_cmpeq_ps(denom, zero), _mm_cmpgt_ps(k, one) ),
+							_mm_or_ps( _mm_or_ps( _mm_cmplt_ps(k, zero), _mm_cmpgt_ps(mu, one) ), _mm_cmplt_ps(mu, zero) ) ),
+					// the error bounds of 'SegInDoubt'
+					scale_d  = _mm_mul_ps( bound, _mm_add_ps( _mm_andnot_ps(sign, d1), _mm_andnot_ps(sign, d2) ) ),
+					scale_k  = _mm_mul_ps( bound, _mm_add_ps( _mm_andnot_ps(sign, k1), _mm_andnot_ps(sign, k2) ) ),
+					scale_mu = _mm_mul_ps( bound, _mm_add_ps( _mm_andnot_ps(sign, m1), _mm_andnot_ps(sign, m2) ) ),
+					unsure = _mm_or_ps(
+							_mm_or_ps( _mm_cmplt_ps( _mm_andnot_ps(sign, num_k), scale_k ),
+									   _mm_cmplt_ps( _mm_andnot_ps(sign, num_mu), scale_mu ) ),
+							_mm_or_ps( _mm_cmplt_ps( _mm_andnot_ps( sign, _mm_sub_ps(denom, num_k) ), _mm_add_ps(scale_d, scale_k) ),
+									   _mm_cmplt_ps( _mm_andnot_ps( sign, _mm_sub_ps(denom, num_mu) ), _mm_add_ps(scale_d, scale_mu) ) ) ),
+					ends_at = _mm_and_ps( _mm_cmpeq_ps(cx, vbx), _mm_cmpeq_ps(cy, vby) ),
+					shared = _mm_or_ps( ends_at, _mm_and_ps( _mm_cmpeq_ps(dx, vax), _mm_cmpeq_ps(dy, vay) ) );
+			unsure = _mm_or_ps( _mm_cmplt_ps( _mm_andnot_ps(sign, denom), scale_d ), _mm_andnot_ps(shared, unsure) );
+			_mm_storeu_ps( kappa + i, k );
+			_mm_storeu_ps( ix + i, _mm_or_ps( _mm_and_ps(ends_at, vbx), _mm_andnot_ps( ends_at, _mm_sub_ps( vax, _mm_mul_ps(k, valx) ) ) ) );
+			_mm_storeu_ps( iy + i, _mm_or_ps( _mm_and_ps(ends_at, vby), _mm_andnot_ps( ends_at, _mm_sub_ps( vay, _mm_mul_ps(k, valy) ) ) ) );
+			mask |= ( ~_mm_movemask_ps(miss) & 0xf ) << i;
+			doubt |= _mm_movemask_ps(unsure) << i;
+		}
+	}
+#endif
+	for ( ; i < n; i ++ )
+	{
+		float	cx = x[i], cy = y[i],
+				bx = x[i+1] - cx, by = y[i+1] - cy,
+				A  = ax - cx, B = ay - cy,
+				denom = bx * aly - alx * by;
+		bool	ends_at = ( cx == bsx and cy == bsy ),
+				shared = ( ends_at or ( x[i+1] == ax and y[i+1] == ay ) );
+		if ( SegInDoubt<float>( A, B, alx, aly, bx, by, shared ) )
+		{
+			doubt |= 1u << i;
 			continue;
 		}
+		float	k  = ( bx * B - by * A ) / denom,
+				mu = ( aly * A - alx * B ) / denom;
+		if ( (k > 1) or (k < 0) or (mu > 1) or (mu < 0) )
+			continue;
+		kappa[i] = k;
+		ix[i] = ( ends_at ? bsx : ax - k * alx );
+		iy[i] = ( ends_at ? bsy : ay - k * aly );
+		mask |= 1u << i;
+	}
 
-		// Set ref to anchor, the point from which the vectors are measured
-		anchor = --candidate;
-		++candidate;
-		// Locally, the path now looks like < ..., *anchor, *candidate, *pt, ... >
+	for ( i = 0; doubt; i ++, doubt >>= 1 )
+	{
+		if ( !(doubt & 1) )
+			continue;
+		CPair pt;
+		if ( SegIntersectExact( seg, { CPair( x[i], y[i] ), CPair( x[i+1], y[i+1] ) }, kappa + i, &pt ) )
+		{
+			ix[i] = pt.GetX(), iy[i] = pt.GetY();
+			mask |= 1u << i;
+		}
+		else
+			mask &= ~(1u << i);
+	}
+	return mask;
+}
 
-		// Determine angle between vectors to 'candidate' and 'pt' from 'anchor'.
-		// 		Vectors to be used in this computation
-		CPair 	v = 	*candidate - *anchor,
-				w = 	*pt		   - *anchor,
-				vperp = v.Normal() * ( candidate->GetSide() == LEFT ? 1 : -1 );
+template <class T>
+bool compare_k( const SIsectDataT<T> & first, const SIsectDataT<T> & second )
+{
+	if ( first.k < second.k )
+		return true;
+	else
+		return false;
+}
 
-		if ( vperp * w > 0 )
+template <class T, class TIsects>
+static int ObstacleIsects( SSegT<T> seg, CObstacleT<T> * obstacle, TIsects * isects, float tolerance )
+/* Sets a vector of parameters, CPairs, and segments (of the obstacle) intersected,
+ * sorted in order of intersection by the parameter list of 'k's.
+ * The candidate edges are kept where 'isects' keeps its nodes (the heap, or an arena). */
+{
+	typedef typename allocator_traits<typename TIsects::allocator_type>::template rebind_alloc<int> TIntAlloc;
+	int num = 0;
+	// Cull the whole obstacle ('Misses' starts with its box), then the edges, before doing any edge math
+	vector<int, TIntAlloc> edges( TIntAlloc( isects->get_allocator() ) );
+	if ( obstacle->Misses(seg) or !obstacle->EdgeCandidates( seg, &edges ) )
+		return 0;
+	{// Get the intersection info, a run of consecutive candidate edges at a time
+		SPtsViewT<T> pts = obstacle->Pts();
+		typename SCoord<T>::real kappa[EDGE_BLOCK];
+		T ix[EDGE_BLOCK], iy[EDGE_BLOCK];
+		for ( unsigned int j = 0; j < edges.size(); )
 		{
-			list<CPair> path = {*anchor, *candidate, *pt};
-			list<CPair> altpath = FindPath( {*anchor, *pt}, obstacles, tolerance );
-#if DEBUGGING
-			cout << "\t old path of length " << PathLen(&path) << " is " << endl;	//DEBUG LINE
-			PrintPath(&path);														//DEBUG LINE
-			cout << "\t alternate path of length " << PathLen(&altpath) << " is " << endl;//DEBUG LINE
-			PrintPath(&altpath);													//DEBUG LINE
-#endif
-			if ( PathLen(&altpath) < PathLen(&path) )
+			int first = edges[j], n = 1;
+			while ( j + n < edges.size() and edges[j+n] == first + n and n < EDGE_BLOCK )
+				n ++;
+			j += n;
+
+			//The work is done here
+			unsigned int hits = SegIntersectBlock( seg, pts.x + first, pts.y + first, n, kappa, ix, iy );
+			for ( int i = 0; hits; i ++, hits >>= 1 )
 			{
-				altpath.pop_front();
-				altpath.pop_back();
-#if DEBUGGING
-				cout << candidate->SPrint() << " replaced";				//DEBUG LINE
-#endif				
-				if ( altpath.size() > 0 )
+				if ( (hits & 1) and (kappa[i] >= tolerance and kappa[i] <= 1 - tolerance) )
 				{
-#if DEBUGGING
-					cout << " by ";										//DEBUG LINE
-					PrintPath(&altpath);								//DEBUG LINE
-#endif
-					sequence->insert( candidate, altpath.begin(), altpath.end() );
+					int edge = first + i;
+					SSegT<T> o_seg = { CPairT<T>( pts.x[edge], pts.y[edge] ), CPairT<T>( pts.x[edge+1], pts.y[edge+1] ) };
+					isects->push_back( { kappa[i], CPairT<T>( ix[i], iy[i] ), o_seg, edge } ), num ++;
 				}
-#if DEBUGGING
-				else													//DEBUG LINE
-					cout << endl;										//DEBUG LINE
-#endif
-				sequence->erase(candidate);
-#if DEBUGGING
-				cout << "new path is ";									//DEBUG LINE
-				PrintPath(sequence);									//DEBUG LINE
-#endif
-				path_not_shortened = false;
 			}
 		}
-#if DEBUGGING
-		else
-		{																//DEBUG BLOCK
-			cout << "\t failed to remove waypoint " << candidate->SPrint() << endl;
-			cout << "\t\t <*anchor, *candidate, *pt> is " << anchor->SPrint() << ", " << candidate->SPrint() << ", " << pt->SPrint() << endl;
-			cout << "\t\tdot prod is " << vperp * w << endl;
-			cout << "\t\tvperp is " << vperp.SPrint() << ". v is " << v.SPrint() << ". w is " << w.SPrint() << endl;
-
-		}
-#endif		
-		if ( path_not_shortened )
-			++ pt;
 	}
-#if DEBUGGING
-	cout << endl << "Optimization complete; no more waypoints could be removed/altered" << endl;					//DEBUG LINE
-#endif
-	return false;
+	// If there aren't multiple intersections, no sorting is needed!
+	if ( isects->size() < 2 )	
+		return 0;
+	//Arrange info by k-value
+	isects->sort( compare_k<T> );
+
+	return num;
+}
+
+template <class T>
+int ObstacleIntersection( SSegT<T> seg, CObstacleT<T> * obstacle, list< SIsectDataT<T> > * isects, float tolerance )
+{
+	return ObstacleIsects( seg, obstacle, isects, tolerance );
 }
 
+template <class T>
+int ObstacleIntersection( SSegT<T> seg, CObstacleT<T> * obstacle, CArenaIsectsT<T> * isects, float tolerance )
+{
+	return ObstacleIsects( seg, obstacle, isects, tolerance );
+}
 
+template <class T>
+CObstacleIndexT<T>::CObstacleIndexT( list< CObstacleT<T> > * obstacles )
+{
+	for ( CObstacleT<T> & obstacle : *obstacles )
+		this->obstacles.push_back(&obstacle);
+	this->pager = 0;
+	this->Rebuild();
+}
 
-/// MAIN ///////////////////////////////////////////////////////////////
+template <class T>
+void CObstacleIndexT<T>::Rebuild(void)
+/* Builds the hierarchy afresh over the live obstacles. 'Build' works on their positions in 'order',
+ * so that the boxes take room for the live obstacles only, however sparse their numbers are. */
+{
+	vector< SBoxT<T> > boxes;
+	vector<int> numbers;
+	this->order.clear();
+	this->nodes.clear();
+	this->loose.clear();
+	this->in_tree.assign( this->obstacles.size(), 1 );
+	for ( unsigned int n = 0; n < this->obstacles.size(); n ++ )
+	{
+		if ( !this->obstacles[n] )
+			continue;
+		this->obstacles[n]->BuildIndex();
+		boxes.push_back( this->obstacles[n]->Bounds() );
+		this->order.push_back( numbers.size() );
+		numbers.push_back(n);
+	}
+	if ( !this->order.empty() )
+		this->Build( &boxes, 0, this->order.size() );
+	for ( int & n : this->order )
+		n = numbers[n];
+}
 
-int main(int argc, char **argv)
+template <class T>
+int CObstacleIndexT<T>::Insert( CObstacleT<T> * obstacle )
 {
-	//Test Data
-	list<CPair> 	Obstacle1 =
-	{ CPair(24,6), CPair(28,6), CPair(28,12), CPair(26,17), CPair(25,19),
-	  CPair(23,25), CPair(21,30), CPair(19,34), CPair(15,34), CPair(14,31),
-	  CPair(14,26), CPair(15,22), CPair(19,12), CPair(20,5) },
-					Obstacle2 = { CPair(10,10), CPair(15,2), CPair(12,15) };
+	obstacle->BuildIndex();
+	this->obstacles.push_back(obstacle);
+	this->in_tree.push_back(0);
+	this->loose.push_back( this->obstacles.size() - 1 );
+	if ( this->loose.size() > INDEX_LOOSE_MAX )
+		this->Rebuild();
+	return this->obstacles.size() - 1;
+}
 
-	CObstacle 	obstacle1(&Obstacle1),
-				obstacle2(&Obstacle2);
+template <class T>
+void CObstacleIndexT<T>::Insert( int n, CObstacleT<T> * obstacle )
+{
+	obstacle->BuildIndex();
+	if ( n >= (int)this->obstacles.size() )
+	{
+		this->obstacles.resize( n + 1, 0 );
+		this->in_tree.resize( n + 1, 0 );
+	}
+	this->obstacles[n] = obstacle;
+	this->in_tree[n] = 0;
+	this->loose.push_back(n);
+	if ( this->loose.size() > INDEX_LOOSE_MAX )
+		this->Rebuild();
+}
 
-	//Print out the obstacle data
-	cout << "Obstacles:" << endl;
-	obstacle1.Print();
-	obstacle2.Print();
+template <class T>
+void CObstacleIndexT<T>::Update( int n )
+{
+	this->obstacles[n]->BuildIndex();
+	if ( this->in_tree[n] )
+	{
+		this->in_tree[n] = 0;
+		this->loose.push_back(n);
+	}
+	if ( this->loose.size() > INDEX_LOOSE_MAX )
+		this->Rebuild();
+}
 
-	{//We do a quick test of the functions declared above.
-		CPair start = CPair(6,7), end = CPair(32,23);
-		cout << endl << "FindPath test:" << endl;
-		list<CObstacle> obs_list;
-		list<CPair> route2,
-					obs1_pts = obstacle1.GetPts(),
-					obs2_pts = obstacle2.GetPts();
-		
-		//Package obstacles in a list for processing convenience.
-		obs_list.push_back(obstacle1);
-		obs_list.push_back(obstacle2);
-
-		//Find an avoidance path from start to end.
-		cout << "Find a path around these obstacles from " 
-			 << start.SPrint() << " to " << end.SPrint() << " ..."
-			 << endl;
-		route2 = FindPath( {start, end}, &obs_list );
-		cout << "Path finding complete!" << endl;
-
-		//Print out the result.
-		cout << "---------------------------" << endl
-			 << "Original route:" << endl;
-		PrintPath(&route2);
-		cout << "of length " << PathLen(&route2) << endl;
-
-		//Optimize the route by cutting empty corners.
-		OptimizePath( &route2, &obs_list, 0.001 );
-
-		//Print the optimized route.
-		cout << "---------------------------" << endl
-			 << "Optimized route is" << endl;
-		PrintPath(&route2);
-		cout << "of length " << PathLen(&route2) << endl;
-		cout << "---------------------------" << endl;
-
-		//Print out some WxMaxima code so that you can visualize what
-		// the program has done.
-		PrintWXMaxGraph(&route2, "path");
-		cout << endl;
-		PrintWXMaxGraph(&obs1_pts, "first obstacle");
-		cout << endl;
-		PrintWXMaxGraph(&obs2_pts, "second obstacle");
-	}
-
-	return 0;
+template <class T>
+void CObstacleIndexT<T>::Remove( int n )
+{
+	this->obstacles[n] = 0;
+	this->in_tree[n] = 0;
+	this->loose.erase( remove( this->loose.begin(), this->loose.end(), n ), this->loose.end() );
 }
+
+template <class T>
+int CObstacleIndexT<T>::Build( vector< SBoxT<T> > * boxes, int lo, int hi )
+/* Unlike edges, obstacles come in no particular order, so we split at the median box centre
+ * along the longer side of the node. Returns the index of the subtree root. */
+{
+	int root = this->nodes.size();
+	SBoxT<T> box = (*boxes)[ this->order[lo] ];
+	for ( int i = lo + 1; i < hi; i ++ )
+		box = BoxUnion( box, (*boxes)[ this->order[i] ] );
+	this->nodes.push_back( { box, lo, hi - lo } );
+
+	if ( hi - lo > BVH_LEAF_SIZE )
+	{
+		int mid = lo + (hi - lo) / 2;
+		bool by_x = ( box.xmax - box.xmin >= box.ymax - box.ymin );
+		nth_element( this->order.begin() + lo, this->order.begin() + mid, this->order.begin() + hi,
+			[boxes, by_x]( int m, int n )
+			{
+				SBoxT<T> & a = (*boxes)[m], & b = (*boxes)[n];
+				return ( by_x ? a.xmin + a.xmax < b.xmin + b.xmax : a.ymin + a.ymax < b.ymin + b.ymax );
+			} );
+		this->Build( boxes, lo, mid );
+		int right = this->Build( boxes, mid, hi ); // may reallocate 'nodes'
+		this->nodes[root].first = right;
+		this->nodes[root].count = 0;
+	}
+	return root;
+}
+
+template <class T>
+unsigned int CObstacleIndexT<T>::size(void)
+{
+	return this->obstacles.size();
+}
+
+template <class T>
+CObstacleT<T> * CObstacleIndexT<T>::Obstacle( int n )
+{
+	return this->obstacles[n];
+}
+
+template <class T>
+template <class TInts>
+int CObstacleIndexT<T>::Candidates( SSegT<T> seg, TInts * hits )
+/* The slots the hierarchy gives are turned into obstacle numbers in place, so nothing else is allocated. */
+{
+	hits->clear();
+	if ( this->pager )
+		this->pager->Page(seg);
+	QueryBVH( &this->nodes, seg, hits );
+	unsigned int kept = 0;
+	for ( int slot : *hits )
+	{
+		int n = this->order[slot];
+		if ( this->in_tree[n] and BoxHitsSeg( this->obstacles[n]->Bounds(), seg ) )
+			(*hits)[kept ++] = n;
+	}
+	hits->resize(kept);
+	for ( int n : this->loose )
+	{
+		if ( BoxHitsSeg( this->obstacles[n]->Bounds(), seg ) )
+			hits->push_back(n);
+	}
+	sort( hits->begin(), hits->end() );
+	return hits->size();
+}
+
+template <class T>
+bool CObstacleIndexT<T>::Blocked( SSegT<T> seg, float tolerance )
+{
+	vector<int> hits;
+	this->Candidates( seg, &hits );
+	for ( int n : hits )
+	{
+		list< SIsectDataT<T> > isects;
+		if ( ObstacleIntersection( seg, this->obstacles[n], &isects, tolerance ) )
+			return true;
+	}
+	return false;
+}
+
+template <class T>
+void CObstacleIndexT<T>::SetPager( CTiledSceneT<T> * pager )
+{
+	this->pager = pager;
+}
+
+template <class T>
+int Circumvent( int entry, int exit, CObstacleT<T> * obstacle, bool clockwise, CArenaPathT<T> * route )
+/* Index-based 'Circumvent': appends to 'route' the vertices of 'obstacle' met when walking
+ * from offset 'entry' in the direction given by 'clockwise', up to the first vertex that coincides
+ * with the one at offset 'exit' (a closed obstacle repeats its first vertex at the end).
+ * A negative 'entry' walks the vertices as they are stored; a negative 'exit' walks all the way round.
+ * Nothing is allocated apart from the new nodes of 'route' (from its arena). Returns the number of vertices appended. */
+{
+	int n = obstacle->size(), len = n + 1, num = 0;
+	if ( n == 0 )
+		return 0;
+	if ( entry < 0 )
+		entry = ( clockwise ? 0 : n - 1 ), len = n;
+
+	SPtsViewT<T> pts = obstacle->Pts();
+	for ( int i = entry; num < len; i = ( clockwise ? (i + 1) % n : (i + n - 1) % n ) )
+	{
+		CPairT<T> pt = obstacle->Pt(i);
+		pt.SetOnObstacle(true);
+		pt.SetClockwise( not clockwise );
+		if ( clockwise == false )
+			pt.SetSide( not pt.GetSide() ); // as though the obstacle had been reversed
+		route->push_back(pt), num ++;
+
+		if ( exit >= 0 and pts.x[i] == pts.x[exit] and pts.y[i] == pts.y[exit] )
+			break;
+	}
+	return num;
+}
+
+template <class T>
+list< CPairT<T> > Circumvent( SSegT<T> seg, CObstacleT<T> * obstacle, bool clockwise )
+/* Given a segment 'seg' to describe entry and exit points on 'obstacle',
+ * and given a direction of travel by 'clockwise',
+ * this function returns a path along 'obstacle'. */
+{
+	CArena arena;
+	CArenaPathT<T> route(&arena);
+	Circumvent( obstacle->Index(seg.start), obstacle->Index(seg.end), obstacle, clockwise, &route );
+#if DEBUGGING
+	PrintPath(&route);
+#endif
+	return list< CPairT<T> >( route.begin(), route.end() );
+}
+
+template <class T>
+typename SCoord<T>::real SegLen( CPairT<T> start, CPairT<T> end )
+{
+	CPairT<T> v = end - start;
+	typename SCoord<T>::real len = sqrt(v * v);
+	return len;
+}
+
+template <class T>
+typename SCoord<T>::real PathLen( list< CPairT<T> > * ptlist )
+{
+	typename SCoord<T>::real length = 0;
+	bool first = true;
+	CPairT<T> oldpt = ptlist->front();
+	for ( CPairT<T> & pt : *ptlist )
+	{
+		if ( first )
+		{
+			first = false;
+			continue;
+		}
+
+		length += SegLen( oldpt, pt );
+
+		oldpt = pt;
+	}
+	return length;
+}
+
+template <class T>
+typename SCoord<T>::real PathLen( CArenaPathT<T> * ptlist )
+{
+	typename SCoord<T>::real length = 0;
+	bool first = true;
+	CPairT<T> oldpt = ptlist->front();
+	for ( CPairT<T> & pt : *ptlist )
+	{
+		if ( first )
+		{
+			first = false;
+			continue;
+		}
+
+		length += SegLen( oldpt, pt );
+
+		oldpt = pt;
+	}
+	return length;
+}
+
+template <class T>
+list< CPairT<T> > minCircumvent( SSegT<T> seg, CObstacleT<T> * obstacle )
+/* Just like 'Circumvent', only this function computes clockwise and cclockwise paths,
+ * returning the shorter of the two. */
+{
+	CArena arena;
+	CArenaPathT<T> 		path1(&arena),
+					path2(&arena);
+	Circumvent( obstacle->Index(seg.start), obstacle->Index(seg.end), obstacle, true, &path1 );
+	Circumvent( obstacle->Index(seg.start), obstacle->Index(seg.end), obstacle, false, &path2 );
+
+	typename SCoord<T>::real	len1 = PathLen(&path1),
+								len2 = PathLen(&path2);
+#if DEBUGGING
+	cout << len1 << ", " << len2 << endl;								//DEBUG LINE
+#endif
+
+	if (len1 < len2)
+		return list< CPairT<T> >( path1.begin(), path1.end() );
+	else
+		return list< CPairT<T> >( path2.begin(), path2.end() );
+}
+
+template <class T>
+CPathMemoT<T>::CPathMemoT()
+	: routes( 0, SPathKeyHashT<T>(), equal_to< SPathKeyT<T> >(), &this->arena )
+{
+}
+
+template <class T>
+SPathKeyT<T> CPathMemoT<T>::Key( SSegT<T> seg, int first, float tolerance )
+{
+	SPathKeyT<T> key;
+	T coords[4] = { seg.start.GetX(), seg.start.GetY(), seg.end.GetX(), seg.end.GetY() };
+	memcpy( key.bits, coords, sizeof(coords) );
+	memcpy( (char *)key.bits + sizeof(coords), &tolerance, sizeof(tolerance) );
+	key.flags[0] = seg.start.GetOnObstacle() | seg.start.GetClockwise() << 1 | seg.start.GetSide() << 2;
+	key.flags[1] = seg.end.GetOnObstacle()   | seg.end.GetClockwise()   << 1 | seg.end.GetSide()   << 2;
+	key.first = first;
+	return key;
+}
+
+template <class T>
+bool CPathMemoT<T>::Find( SPathKeyT<T> key, CArenaPathT<T> * route )
+/* Copies the route remembered for 'key' into 'route' (whose arena it then lives in). */
+{
+	typename TRouteMap::iterator it = this->routes.find(key);
+	if ( it == this->routes.end() )
+		return false;
+	route->assign( it->second.begin(), it->second.end() );
+	return true;
+}
+
+template <class T>
+bool CPathMemoT<T>::Contains( SPathKeyT<T> key )
+{
+	return ( this->routes.count(key) > 0 );
+}
+
+template <class T>
+void CPathMemoT<T>::Store( SPathKeyT<T> key, CArenaPathT<T> * route )
+/* Remembers a copy of 'route', kept in the memo's own arena. */
+{
+	typename TRouteMap::iterator it = this->routes.find(key);
+	if ( it != this->routes.end() )
+		it->second.assign( route->begin(), route->end() );
+	else
+		this->routes.emplace( key, CArenaPathT<T>( route->begin(), route->end(), &this->arena ) );
+}
+
+template <class T>
+unsigned int CPathMemoT<T>::size(void)
+{
+	return this->routes.size();
+}
+
+template <class T>
+void CPathMemoT<T>::clear(void)
+{
+	{// the table itself lives in the arena too, so it goes before the arena is released
+		TRouteMap empty( 0, SPathKeyHashT<T>(), equal_to< SPathKeyT<T> >(), &this->arena );
+		this->routes.swap(empty);
+	}
+	this->arena.Release();
+}
+
+struct SStatsLevel
+/* Counts a level of 'FindPath' in the running query (if any), and its depth while it lasts. */
+{
+	SStatsLevel()
+	{
+		if ( query_stats )
+		{
+			query_stats->findpath_calls ++;
+			query_stats->max_depth = max( query_stats->max_depth, ++ query_stats->depth );
+		}
+	}
+	~SStatsLevel()
+	{
+		if ( query_stats )
+			query_stats->depth --;
+	}
+};
+
+template <class T>
+CArenaPathT<T> FindPath( typename SSegArg<T>::type seg, CObstacleIndexT<T> * index, int first, float tolerance, CPathMemoT<T> * memo, CArena * arena )
+/* Finds a route for 'seg' around the obstacles number 'first' onwards of 'index', in order.
+ * The obstacles are shared by every level of the recursion: a level only advances 'first'.
+ * 'memo' may be null; otherwise it must only ever have been used with 'index'.
+ * Every path built on the way, the route included, is allocated from 'arena'. */
+{
+	SStatsLevel level;
+	SPathKeyT<T> key = CPathMemoT<T>::Key( seg, first, tolerance );
+	CArenaPathT<T> route(arena);
+	if ( memo and memo->Find( key, &route ) )
+	{
+		if ( query_stats )
+			query_stats->memo_hits ++;
+		return route;
+	}
+
+	// Look for the next obstacle in the way, among those the index cannot rule out
+	CArenaInts candidates(arena);
+	CArenaIsectsT<T> isects(arena);// replaces the previous three data lists
+	CObstacleT<T> * obstacle = 0;
+	index->Candidates( seg, &candidates );
+#if DEBUGGING
+	cout << index->size() - first << " obstacle(s) remain(s)" << endl;	//DEBUG LINE
+#endif
+	for ( int n : candidates )
+	{
+		if ( n < first )
+			continue;
+#if DEBUGGING
+		cout << "active obstacle is ";									//DEBUG LINE
+		index->Obstacle(n)->Print();									//DEBUG LINE
+#endif
+		if ( query_stats )
+			query_stats->obstacles_tested ++;
+		if ( ObstacleIntersection( seg, index->Obstacle(n), &isects, tolerance ) )
+		{
+			obstacle = index->Obstacle(n);
+			first = n + 1;
+			break;
+		}
+		isects.clear();
+#if DEBUGGING
+		cout << "No intersection with obstacle " << n << endl;			//DEBUG LINE
+#endif
+	}
+
+	// Stop recurring if there are no more obstacles in the way
+	if ( !obstacle )
+	{
+#if DEBUGGING
+		cout << "no more obstacles" << endl;							//DEBUG LINE
+#endif
+		route = {seg.start, seg.end};
+		if ( memo )
+			memo->Store( key, &route );
+		return route;
+	}
+
+	// else, we have a naive path to be broken down (for now, we ignore any intermediate intersections as irrelevant):
+	//	seg.start, isect[0], ... , isect[n], seg.end
+	// we assume the last intersection is the exit point. Bad things happen/get ignored if the destination is inside an obstacle.
+	if ( query_stats )
+		query_stats->branches ++;
+	CPairT<T> 	i_pt_in  = isects.front().pair,
+			i_pt_out = isects.back().pair; 
+	bool orientation;
+
+	i_pt_out.SetOnObstacle(true);
+
+	// Now, navigate around the obstacle
+	CArenaPathT<T> path1(arena);
+	Circumvent( obstacle->Vertex( isects.front().edge + 1 ), obstacle->Vertex( isects.back().edge ), obstacle, RIGHT, &path1 );
+	orientation = path1.begin()->GetSide();
+	i_pt_in.SetSide(orientation);
+	i_pt_out.SetSide(orientation);
+#if DEBUGGING
+	cout << "intersections with obstacle are " << i_pt_in.SPrint() << "and" << i_pt_out.SPrint() << endl;
+	cout << "path1 orientation has been set to " << ( path1.begin()->GetSide() ? 'L' : 'R' ) << endl;
+#endif
+	path1.push_front(i_pt_in);
+	path1.push_back(i_pt_out);
+
+	CArenaPathT<T> path2(arena);
+	Circumvent( obstacle->Vertex( isects.front().edge ), obstacle->Vertex( isects.back().edge + 1 ), obstacle, LEFT, &path2 );
+	orientation = path2.begin()->GetSide();
+	i_pt_in.SetSide(orientation);
+	i_pt_out.SetSide(orientation);
+#if DEBUGGING
+	cout << "path2 orientation has been set to " << ( path2.begin()->GetSide() ? 'L' : 'R' ) << endl;
+#endif
+	path2.push_front(i_pt_in);
+	path2.push_back(i_pt_out);
+
+	//Choose the path with minimal length
+	typename SCoord<T>::real	len1 = PathLen(&path1),
+								len2 = PathLen(&path2);
+	CArenaPathT<T> & path = ( (len1 < len2) ? path1 : path2 );
+#if DEBUGGING
+	cout << len1 << ", " << len2 << endl;								//DEBUG LINE
+	if (len1 < len2)
+		cout << "chose path1 for its local efficiency:";				//DEBUG LINE
+	else
+		cout << "chose path2 for its local efficiency:";				//DEBUG LINE
+	cout << endl;														//DEBUG LINE
+	PrintPath(&path);
+#endif
+	// Figure out the rest of the path (looking for ways around the other obstacles) ...
+#if DEBUGGING
+	cout << index->size() - first << endl;								//DEBUG LINE
+	cout << "Moving to next of " << index->size() - first << " obstacles" << endl;//DEBUG LINE
+	cout << "in-vector is ";
+	PrintSeg( SSegT<T>{seg.start, i_pt_in} );										//DEBUG LINE
+	cout << "out-vector is ";
+	PrintSeg( SSegT<T>{i_pt_out,  seg.end} );										//DEBUG LINE
+#endif
+	//.. by splitting the path and recurring to remaining obstacles
+	CArenaPathT<T> prepath  = FindPath( {seg.start, i_pt_in}, index, first, tolerance, memo, arena );
+	CArenaPathT<T> postpath = FindPath( {i_pt_out,  seg.end}, index, first, tolerance, memo, arena );
+
+	prepath.pop_back();  //important: unique gets rid of the wrong pts
+	postpath.pop_front();//important: unique gets rid of the wrong pts
+	route.splice( route.end(), prepath );// all in the one arena, so the nodes just move over
+	route.splice( route.end(), path );
+	route.splice( route.end(), postpath );
+	route.unique();
+	if ( memo )
+		memo->Store( key, &route );
+	return route;
+}
+
+template <class T>
+list< CPairT<T> > FindPath( typename SSegArg<T>::type seg, CObstacleIndexT<T> * index, int first, float tolerance, CPathMemoT<T> * memo )
+{
+	CStatsScope scope(seg);
+	double started = ( query_stats ? StatsMicros() : 0 );
+	CArena arena;
+	CArenaPathT<T> route = FindPath( seg, index, first, tolerance, memo, &arena );
+	if ( query_stats )
+	{
+		query_stats->findpath_us += StatsMicros() - started;
+		query_stats->arena_bytes += arena.Capacity();
+	}
+	return list< CPairT<T> >( route.begin(), route.end() );
+}
+
+template <class T>
+list< CPairT<T> > FindPath( typename SSegArg<T>::type seg, CObstacleIndexT<T> * index, float tolerance, CPathMemoT<T> * memo )
+{
+	return FindPath( seg, index, 0, tolerance, memo );
+}
+
+template <class T>
+list< CPairT<T> > FindPath( typename SSegArg<T>::type seg, list< CObstacleT<T> > * obstacles, float tolerance )
+{
+	CObstacleIndexT<T> index(obstacles);
+	CPathMemoT<T> memo;
+	return FindPath( seg, &index, tolerance, &memo );
+}
+
+template <class T>
+list< CPairT<T> > FindPath( typename SSegArg<T>::type seg, list< CObstacleT<T> > * obstacles)
+{
+	return FindPath( seg, obstacles, 0 );
+}
+
+/// Thread pool ////////////////////////////////////////////////////////
+
+CThreadPool::CThreadPool( unsigned int threads )
+{
+	if ( threads == 0 )
+		threads = max( 1u, thread::hardware_concurrency() );
+	this->queued = this->pending = 0;
+	this->next = 0;
+	this->stopping = false;
+	for ( unsigned int i = 0; i < threads; i ++ )
+		this->queues.push_back( new SWorkQueue );
+	for ( unsigned int i = 0; i < threads; i ++ )
+		this->threads.push_back( thread( &CThreadPool::Run, this, i ) );
+}
+
+CThreadPool::~CThreadPool()
+{
+	{
+		lock_guard<mutex> guard(this->lock);
+		this->stopping = true;
+	}
+	this->wake.notify_all();
+	for ( thread & t : this->threads )
+		t.join();
+	for ( SWorkQueue * queue : this->queues )
+		delete queue;
+}
+
+unsigned int CThreadPool::size(void)
+{
+	return this->threads.size();
+}
+
+void CThreadPool::Submit( function<void(int)> task )
+{
+	SWorkQueue * queue;
+	{
+		lock_guard<mutex> guard(this->lock);
+		queue = this->queues[ this->next ++ % this->queues.size() ];
+	}
+	{
+		lock_guard<mutex> guard(queue->lock);
+		queue->tasks.push_back(task);
+	}
+	{
+		lock_guard<mutex> guard(this->lock);
+		this->queued ++, this->pending ++;
+	}
+	this->wake.notify_one();
+}
+
+void CThreadPool::Wait(void)
+{
+	unique_lock<mutex> guard(this->lock);
+	this->idle.wait( guard, [this] { return this->pending == 0; } );
+}
+
+bool CThreadPool::Take( int worker, function<void(int)> * task )
+{
+	int n = this->queues.size();
+	for ( int i = 0; i < n; i ++ )
+	{
+		SWorkQueue * queue = this->queues[ (worker + i) % n ];
+		lock_guard<mutex> guard(queue->lock);
+		if ( queue->tasks.empty() )
+			continue;
+		if ( i == 0 )
+			*task = queue->tasks.back(), queue->tasks.pop_back();
+		else
+			*task = queue->tasks.front(), queue->tasks.pop_front();
+		return true;
+	}
+	return false;
+}
+
+void CThreadPool::Run( int worker )
+{
+	function<void(int)> task;
+	while ( true )
+	{
+		if ( this->Take( worker, &task ) )
+		{
+			{
+				lock_guard<mutex> guard(this->lock);
+				this->queued --;
+			}
+			task(worker);
+			task = nullptr;
+			lock_guard<mutex> guard(this->lock);
+			if ( -- this->pending == 0 )
+				this->idle.notify_all();
+			continue;
+		}
+		unique_lock<mutex> guard(this->lock);
+		this->wake.wait( guard, [this] { return this->stopping or this->queued > 0; } );
+		if ( this->stopping and this->queued == 0 )
+			return;
+	}
+}
+
+/// Path optimization ////////////////////////////////////////////////
+
+template <class T>
+bool CornerCuttable( CPairT<T> anchor, CPairT<T> candidate, CPairT<T> pt )
+/* Whether the route < ..., anchor, candidate, pt, ... > turns away from the side
+ * 'candidate' was passed on, so that going straight from 'anchor' to 'pt' might be shorter. */
+{
+	// Determine angle between vectors to 'candidate' and 'pt' from 'anchor'.
+	// 		Vectors to be used in this computation
+	CPairT<T> 	v = 	candidate - anchor,
+			w = 	pt		  - anchor,
+			vperp = v.Normal() * ( candidate.GetSide() == LEFT ? 1 : -1 );
+
+	return ( vperp * w > 0 );
+}
+
+#define SHORTCUT_WINDOW	4	// shortcuts tried ahead of the serial pass, per worker
+
+template <class T>
+void PrefetchShortcuts( typename CArenaPathT<T>::iterator pt, CArenaPathT<T> * sequence, CObstacleIndexT<T> * index, float tolerance,
+						CPathMemoT<T> * memo, CThreadPool * pool, vector< CPathMemoT<T> > * scratch, vector<CArena> * arenas )
+/* Speculates that the route from 'pt' on stays as it is, and solves the shortcuts
+ * 'OptimizePath' would then try next on the workers of 'pool' (each with its memo in 'scratch'
+ * and its arena in 'arenas'). The routes go into 'memo', where the serial pass finds those that still apply. */
+{
+	vector< SSegT<T> > shortcuts;
+	for ( ; pt != sequence->end() and shortcuts.size() < SHORTCUT_WINDOW * pool->size(); ++ pt )
+	{
+		typename CArenaPathT<T>::iterator candidate = pt, anchor;
+		if ( -- candidate == sequence->begin() )
+			continue;
+		anchor = candidate;
+		-- anchor;
+		if ( CornerCuttable( *anchor, *candidate, *pt )
+			 and !memo->Contains( CPathMemoT<T>::Key( {*anchor, *pt}, 0, tolerance ) ) )
+			shortcuts.push_back( {*anchor, *pt} );
+	}
+
+	vector< CArenaPathT<T> > routes( shortcuts.size() );
+	for ( unsigned int i = 0; i < shortcuts.size(); i ++ )
+	{
+		SSegT<T> shortcut = shortcuts[i];
+		CArenaPathT<T> * route = &routes[i];
+		pool->Submit( [=]( int worker )
+			{
+				*route = FindPath( shortcut, index, 0, tolerance, &(*scratch)[worker], &(*arenas)[worker] );
+			} );
+	}
+	pool->Wait();
+	for ( unsigned int i = 0; i < shortcuts.size(); i ++ )
+		memo->Store( CPathMemoT<T>::Key( shortcuts[i], 0, tolerance ), &routes[i] );
+	routes.clear();
+	for ( CArena & arena : *arenas )
+		arena.Release();
+}
+
+template <class T>
+bool OptimizePath( CArenaPathT<T> * sequence, CObstacleIndexT<T> * index, float tolerance, CPathMemoT<T> * memo, CThreadPool * pool, CArena * arena, SBudget * budget )
+/* Cuts corners off the route wherever the obstacles allow it.
+ * Given a 'pool' (and a 'memo'), the shortcuts are solved ahead of time in parallel batches
+ * while the pass itself stays serial, so the result is exactly that of the serial pass.
+ * The paths tried on the way are allocated from 'arena'.
+ * Given a 'budget', stops short once it runs out, with the route as far as it got: every shortcut
+ * taken keeps it valid. Returns whether the pass was finished (false if the budget cut it short). */
+{
+	bool path_not_shortened;
+	unsigned long tries = 0;
+	vector< CPathMemoT<T> > scratch( pool ? pool->size() : 0 );
+	vector<CArena> arenas( pool ? pool->size() : 0 );
+	typename CArenaPathT<T>::iterator pt = sequence->begin(), candidate, anchor;
+	advance( pt, 2 );
+#if DEBUGGING
+	cout << "Optimizing---------------" << endl;						//DEBUG LINE
+#endif
+	while ( pt != sequence->end() )
+	{
+		// set a flag to say when to move on (default is 'move on')
+		path_not_shortened = true;
+		
+		// set ref to candidate, the point to be possibly deleted
+		candidate = --pt; 
+		++pt;
+		if ( candidate == sequence->begin() )
+		{
+			++pt;
+			continue;
+		}
+
+		// Set ref to anchor, the point from which the vectors are measured
+		anchor = --candidate;
+		++candidate;
+		// Locally, the path now looks like < ..., *anchor, *candidate, *pt, ... >
+
+		if ( CornerCuttable( *anchor, *candidate, *pt ) )
+		{
+			if ( budget and ( ( budget->shortcuts and tries >= budget->shortcuts )
+							  or ( budget->deadline and StatsMicros() >= budget->deadline ) ) )
+				return false;
+			tries ++;
+			if ( query_stats )
+				query_stats->shortcut_tries ++;
+			if ( pool and memo and !memo->Contains( CPathMemoT<T>::Key( {*anchor, *pt}, 0, tolerance ) ) )
+				PrefetchShortcuts( pt, sequence, index, tolerance, memo, pool, &scratch, &arenas );
+
+			CArenaPathT<T> path( {*anchor, *candidate, *pt}, arena );
+			CArenaPathT<T> altpath = FindPath( {*anchor, *pt}, index, 0, tolerance, memo, arena );
+#if DEBUGGING
+			cout << "\t old path of length " << PathLen(&path) << " is " << endl;	//DEBUG LINE
+			PrintPath(&path);														//DEBUG LINE
+			cout << "\t alternate path of length " << PathLen(&altpath) << " is " << endl;//DEBUG LINE
+			PrintPath(&altpath);													//DEBUG LINE
+#endif
+			if ( PathLen(&altpath) < PathLen(&path) )
+			{
+				if ( query_stats )
+					query_stats->shortcut_takes ++;
+				altpath.pop_front();
+				altpath.pop_back();
+#if DEBUGGING
+				cout << candidate->SPrint() << " replaced";				//DEBUG LINE
+#endif				
+				if ( altpath.size() > 0 )
+				{
+#if DEBUGGING
+					cout << " by ";										//DEBUG LINE
+					PrintPath(&altpath);								//DEBUG LINE
+#endif
+					sequence->insert( candidate, altpath.begin(), altpath.end() );
+				}
+#if DEBUGGING
+				else													//DEBUG LINE
+					cout << endl;										//DEBUG LINE
+#endif
+				sequence->erase(candidate);
+#if DEBUGGING
+				cout << "new path is ";									//DEBUG LINE
+				PrintPath(sequence);									//DEBUG LINE
+#endif
+				path_not_shortened = false;
+			}
+		}
+#if DEBUGGING
+		else
+		{																//DEBUG BLOCK
+			CPairT<T> 	v = 	*candidate - *anchor,
+					w = 	*pt		   - *anchor,
+					vperp = v.Normal() * ( candidate->GetSide() == LEFT ? 1 : -1 );
+			cout << "\t failed to remove waypoint " << candidate->SPrint() << endl;
+			cout << "\t\t <*anchor, *candidate, *pt> is " << anchor->SPrint() << ", " << candidate->SPrint() << ", " << pt->SPrint() << endl;
+			cout << "\t\tdot prod is " << vperp * w << endl;
+			cout << "\t\tvperp is " << vperp.SPrint() << ". v is " << v.SPrint() << ". w is " << w.SPrint() << endl;
+
+		}
+#endif		
+		if ( path_not_shortened )
+			++ pt;
+	}
+#if DEBUGGING
+	cout << endl << "Optimization complete; no more waypoints could be removed/altered" << endl;					//DEBUG LINE
+#endif
+	return true;
+}
+
+template <class T>
+bool OptimizePath( CArenaPathT<T> * sequence, CObstacleIndexT<T> * index, float tolerance, CPathMemoT<T> * memo, CThreadPool * pool, CArena * arena )
+{
+	OptimizePath( sequence, index, tolerance, memo, pool, arena, (SBudget *)0 );
+	return false;
+}
+
+template <class T>
+bool OptimizePath( list< CPairT<T> > * sequence, CObstacleIndexT<T> * index, float tolerance, CPathMemoT<T> * memo, CThreadPool * pool )
+{
+	if ( sequence->empty() )
+		return false;
+	CStatsScope scope( SSegT<T>{ sequence->front(), sequence->back() } );
+	double started = ( query_stats ? StatsMicros() : 0 );
+	CArena arena;
+	CArenaPathT<T> route( sequence->begin(), sequence->end(), &arena );
+	bool result = OptimizePath( &route, index, tolerance, memo, pool, &arena );
+	sequence->assign( route.begin(), route.end() );
+	if ( query_stats )
+	{
+		query_stats->optimize_us += StatsMicros() - started;
+		query_stats->arena_bytes += arena.Capacity();
+	}
+	return result;
+}
+
+template <class T>
+bool OptimizePath( list< CPairT<T> > * sequence, CObstacleIndexT<T> * index, float tolerance, CPathMemoT<T> * memo )
+{
+	return OptimizePath( sequence, index, tolerance, memo, 0 );
+}
+
+template <class T>
+bool OptimizePath( list< CPairT<T> > * sequence, list< CObstacleT<T> > * obstacles, float tolerance )
+{
+	CObstacleIndexT<T> index(obstacles);
+	CPathMemoT<T> memo;
+	return OptimizePath( sequence, &index, tolerance, &memo );
+}
+
+
+/// Visibility graph solver ////////////////////////////////////////////
+
+template <class T>
+double Orient( CPairT<T> a, CPairT<T> b, CPairT<T> c )
+/* Returns twice the signed area of the triangle a, b, c:
+ * positive if 'c' lies to the left of the line from 'a' to 'b', negative if to the right. */
+{
+	return ( (double)b.GetX() - a.GetX() ) * ( (double)c.GetY() - a.GetY() )
+		 - ( (double)b.GetY() - a.GetY() ) * ( (double)c.GetX() - a.GetX() );
+}
+
+template <class T>
+CVisibilityGraphT<T>::CVisibilityGraphT( CObstacleIndexT<T> * index )
+{
+	vector<T> nodes[2], prev[2], next[2];
+	this->index = index;
+	this->map = 0;
+	this->map_size = 0;
+	for ( unsigned int n = 0; n < index->size(); n ++ )
+	{
+		CObstacleT<T> * obstacle = index->Obstacle(n);
+		int m = Size(obstacle);
+		this->own_sizes.push_back(m);
+		if ( m < 2 )
+			continue;
+		SPtsViewT<T> pts = obstacle->Pts();
+
+		double area = 0;
+		for ( int i = 0; i < m; i ++ )
+			area += (double)pts.x[i] * pts.y[(i+1) % m] - (double)pts.x[(i+1) % m] * pts.y[i];
+
+		for ( int i = 0; i < m; i ++ )
+		{
+			int before = (i+m-1) % m, after = (i+1) % m;
+			// keep the corners that bulge out of the obstacle (and both tips of a wall)
+			if ( m > 2 and OrientSign( CPairT<T>( pts.x[before], pts.y[before] ), CPairT<T>( pts.x[i], pts.y[i] ),
+									   CPairT<T>( pts.x[after], pts.y[after] ) ) * area <= 0 )
+				continue;
+			nodes[0].push_back( pts.x[i] ), nodes[1].push_back( pts.y[i] );
+			prev[0].push_back( pts.x[before] ), prev[1].push_back( pts.y[before] );
+			next[0].push_back( pts.x[after] ), next[1].push_back( pts.y[after] );
+		}
+	}
+	this->num = nodes[0].size();
+	for ( vector<T> * coords : { nodes, nodes + 1, prev, prev + 1, next, next + 1 } )
+		this->own_corners.insert( this->own_corners.end(), coords->begin(), coords->end() );
+	this->sizes = this->own_sizes.data();
+	this->corners = this->own_corners.data();
+
+	vector< vector<int> > edges( this->num );
+	for ( int i = 0; i < this->num; i ++ )
+	{
+		for ( int j = i + 1; j < this->num; j ++ )
+		{
+			if ( this->Tangent( i, this->Node(j) ) and this->Tangent( j, this->Node(i) )
+				 and this->Visible( this->Node(i), this->Node(j) ) )
+				edges[i].push_back(j), edges[j].push_back(i);
+		}
+	}
+	this->own_adj_start.push_back(0);
+	for ( int i = 0; i < this->num; i ++ )
+	{
+		for ( int j : edges[i] )
+		{
+			this->own_adj.push_back(j);
+			this->own_adj_len.push_back( SegLen( this->Node(i), this->Node(j) ) );
+		}
+		this->own_adj_start.push_back( this->own_adj.size() );
+	}
+	this->num_adj = this->own_adj.size();
+	this->adj_start = this->own_adj_start.data();
+	this->adj = this->own_adj.data();
+	this->adj_len = this->own_adj_len.data();
+}
+
+template <class T>
+CVisibilityGraphT<T>::CVisibilityGraphT( CObstacleIndexT<T> * index, void * map, size_t map_size )
+/* Points the arrays into a mapped navigation file that 'Load' has checked. */
+{
+	const SNavHeader * header = (const SNavHeader *)map;
+	const char * section = (const char *)( header + 1 );
+	this->index = index;
+	this->map = map;
+	this->map_size = map_size;
+	this->num = header->nodes;
+	this->num_adj = header->edges;
+	this->sizes = (const int *)section;
+	section += NavAlign( 4 * (size_t)header->obstacles );
+	this->corners = (const T *)section;
+	section += NavAlign( 6 * sizeof(T) * (size_t)header->nodes );
+	this->adj_start = (const int *)section;
+	section += NavAlign( 4 * ( (size_t)header->nodes + 1 ) );
+	this->adj = (const int *)section;
+	section += NavAlign( 4 * (size_t)header->edges );
+	this->adj_len = (const typename SCoord<T>::real *)section;
+}
+
+template <class T>
+CVisibilityGraphT<T>::~CVisibilityGraphT()
+{
+	if ( this->map )
+		munmap( this->map, this->map_size );
+}
+
+template <class T>
+CPairT<T> CVisibilityGraphT<T>::Node( int i )
+{
+	return CPairT<T>( this->corners[i], this->corners[this->num + i] );
+}
+
+template <class T>
+unsigned int CVisibilityGraphT<T>::size(void)
+{
+	return this->num;
+}
+
+template <class T>
+unsigned int CVisibilityGraphT<T>::Edges(void)
+{
+	return this->num_adj / 2;
+}
+
+template <class T>
+bool CVisibilityGraphT<T>::Mapped(void)
+{
+	return ( this->map != 0 );
+}
+
+template <class T>
+int CVisibilityGraphT<T>::Size( CObstacleT<T> * obstacle )
+{
+	if ( !obstacle )
+		return 0;
+	SPtsViewT<T> pts = obstacle->Pts();
+	int m = pts.n;
+	if ( m > 1 and pts.x[0] == pts.x[m-1] and pts.y[0] == pts.y[m-1] )
+		m --; // the closing point is not a corner of its own
+	return m;
+}
+
+template <class T>
+bool CVisibilityGraphT<T>::Tangent( int node, CPairT<T> from )
+{
+	const T * prev = this->corners + 2 * this->num, * next = prev + 2 * this->num;
+	int		s1 = OrientSign( from, this->Node(node), CPairT<T>( prev[node], prev[this->num + node] ) ),
+			s2 = OrientSign( from, this->Node(node), CPairT<T>( next[node], next[this->num + node] ) );
+	return !( (s1 > 0 and s2 < 0) or (s1 < 0 and s2 > 0) );
+}
+
+template <class T>
+bool CVisibilityGraphT<T>::Inside( int n, double x, double y )
+{
+	SPtsViewT<T> pts = this->index->Obstacle(n)->Pts();
+	int m = this->sizes[n];
+	bool inside = false;
+	if ( m < 3 )
+		return false;
+	for ( int i = 0, j = m - 1; i < m; j = i ++ )
+	{
+		double	ax = pts.x[j], ay = pts.y[j], bx = pts.x[i], by = pts.y[i],
+				cross = (bx - ax) * (y - ay) - (by - ay) * (x - ax),
+				len = sqrt( (bx - ax) * (bx - ax) + (by - ay) * (by - ay) );
+		// on the boundary counts as outside: routes may slide along an edge
+		if ( fabs(cross) <= 1e-6 * len * ( 1 + fabs(x) + fabs(y) )
+			 and x >= min(ax, bx) - 1e-6 and x <= max(ax, bx) + 1e-6
+			 and y >= min(ay, by) - 1e-6 and y <= max(ay, by) + 1e-6 )
+			return false;
+		if ( (ay > y) != (by > y) and x < ax + (bx - ax) * (y - ay) / (by - ay) )
+			inside = !inside;
+	}
+	return inside;
+}
+
+template <class T>
+bool CVisibilityGraphT<T>::Visible( CPairT<T> p, CPairT<T> q )
+/* The segment is blocked if it properly crosses an edge. Otherwise each piece of it between the
+ * obstacle vertices it touches is either wholly inside or wholly outside every obstacle,
+ * which the midpoint of the piece decides. */
+{
+	SSegT<T> seg = {p, q};
+	vector<int> hits, edges;
+	vector<double> touches = { 0, 1 };
+	double	dx = (double)q.GetX() - p.GetX(), dy = (double)q.GetY() - p.GetY(),
+			len2 = dx * dx + dy * dy;
+
+	this->index->Candidates( seg, &hits );
+	for ( int n : hits )
+	{
+		CObstacleT<T> * obstacle = this->index->Obstacle(n);
+		SPtsViewT<T> pts = obstacle->Pts();
+		int m = this->sizes[n];
+		if ( m < 2 )
+			continue;
+		if ( obstacle->Misses(seg) )
+			continue;
+		edges.clear();
+		obstacle->EdgeCandidates( seg, &edges );
+		if ( m == (int)pts.n and m > 2 )
+			edges.push_back( m - 1 ); // the closing edge is not stored
+		if ( query_stats )
+			query_stats->seg_tests += edges.size();
+		for ( int e : edges )
+		{
+			CPairT<T>	a = CPairT<T>( pts.x[e], pts.y[e] ),
+					b = CPairT<T>( pts.x[(e+1) % m], pts.y[(e+1) % m] );
+			int		o1 = OrientSign( p, q, a ),
+					o2 = OrientSign( p, q, b );
+			if ( o1 * o2 < 0 and OrientSign( a, b, p ) * OrientSign( a, b, q ) < 0 )
+				return false;
+			for ( CPairT<T> v : { a, b } )
+			{
+				double t = ( ((double)v.GetX() - p.GetX()) * dx + ((double)v.GetY() - p.GetY()) * dy ) / len2;
+				if ( fabs( Orient( p, q, v ) ) <= 1e-9 * len2 * ( 1 + fabs(v.GetX()) + fabs(v.GetY()) ) and t > 0 and t < 1 )
+					touches.push_back(t);
+			}
+		}
+	}
+
+	sort( touches.begin(), touches.end() );
+	for ( unsigned int i = 0; i + 1 < touches.size(); i ++ )
+	{
+		if ( touches[i+1] - touches[i] < 1e-9 )
+			continue;
+		double	t = ( touches[i] + touches[i+1] ) / 2,
+				x = p.GetX() + t * dx,
+				y = p.GetY() + t * dy;
+		for ( int n : hits )
+		{
+			if ( this->Inside( n, x, y ) )
+				return false;
+		}
+	}
+	return true;
+}
+
+template <class T>
+list< CPairT<T> > CVisibilityGraphT<T>::FindPath( SSegT<T> seg )
+/* A* over the graph, with the straight-line distance to 'seg.end' as the heuristic.
+ * The end points are joined to the corners they see while searching; nothing is added to the graph.
+ * Returns the direct segment if there is no route (e.g. an end point lies inside an obstacle). */
+{
+	int		num = this->num, start = num, goal = num + 1;
+	vector<double> cost( num + 2, HUGE_VAL );
+	vector<int> parent( num + 2, -1 );
+	vector<char> done( num + 2, 0 );
+	priority_queue< pair<double,int>, vector< pair<double,int> >, greater< pair<double,int> > > open;
+
+	if ( this->Visible( seg.start, seg.end ) )
+		return {seg.start, seg.end};
+
+	auto Position = [&]( int i ) { return ( i == start ? seg.start : ( i == goal ? seg.end : this->Node(i) ) ); };
+	auto Relax = [&]( int u, int v, double len )
+	{
+		if ( cost[u] + len < cost[v] )
+		{
+			cost[v] = cost[u] + len;
+			parent[v] = u;
+			open.push( { cost[v] + SegLen( Position(v), seg.end ), v } );
+		}
+	};
+
+	cost[start] = 0;
+	open.push( { SegLen( seg.start, seg.end ), start } );
+	while ( !open.empty() )
+	{
+		int u = open.top().second;
+		open.pop();
+		if ( done[u] )
+			continue;
+		done[u] = 1;
+		if ( u == goal )
+			break;
+
+		if ( u == start )
+		{
+			for ( int v = 0; v < num; v ++ )
+			{
+				if ( this->Tangent( v, seg.start ) and this->Visible( seg.start, this->Node(v) ) )
+					Relax( u, v, SegLen( seg.start, this->Node(v) ) );
+			}
+			continue;
+		}
+		for ( int e = this->adj_start[u]; e < this->adj_start[u+1]; e ++ )
+		{
+			if ( !done[ this->adj[e] ] )
+				Relax( u, this->adj[e], this->adj_len[e] );
+		}
+		if ( this->Tangent( u, seg.end ) and this->Visible( this->Node(u), seg.end ) )
+			Relax( u, goal, SegLen( this->Node(u), seg.end ) );
+	}
+
+	if ( parent[goal] < 0 )
+		return {seg.start, seg.end};
+
+	list< CPairT<T> > route = { seg.end };
+	for ( int v = parent[goal]; v != start; v = parent[v] )
+	{
+		CPairT<T>	corner = this->Node(v);
+		// mark the side so that 'OptimizePath' does not try to cut through the corner
+		bool	left_turn = OrientSign( Position( parent[v] ), corner, route.front() ) > 0;
+		corner.SetOnObstacle(true);
+		corner.SetClockwise( not left_turn );
+		corner.SetSide( left_turn ? RIGHT : LEFT );
+		route.push_front(corner);
+	}
+	route.push_front(seg.start);
+	return route;
+}
+
+template <class T>
+void CVisibilityGraphT<T>::Tree( CPairT<T> goal, vector<double> * cost, vector<int> * toward )
+/* Dijkstra from 'goal', which is joined to the corners it sees. Afterwards 'cost' holds the length of
+ * the shortest route from each node to 'goal' (HUGE_VAL if there is none), and 'toward' the next node on it
+ * (-1 where the route goes straight to 'goal'). */
+{
+	int num = this->num;
+	vector<char> done( num, 0 );
+	priority_queue< pair<double,int>, vector< pair<double,int> >, greater< pair<double,int> > > open;
+
+	cost->assign( num, HUGE_VAL );
+	toward->assign( num, -1 );
+	for ( int v = 0; v < num; v ++ )
+	{
+		if ( this->Tangent( v, goal ) and this->Visible( this->Node(v), goal ) )
+		{
+			(*cost)[v] = SegLen( this->Node(v), goal );
+			open.push( { (*cost)[v], v } );
+		}
+	}
+	while ( !open.empty() )
+	{
+		int u = open.top().second;
+		open.pop();
+		if ( done[u] )
+			continue;
+		done[u] = 1;
+		for ( int e = this->adj_start[u]; e < this->adj_start[u+1]; e ++ )
+		{
+			int v = this->adj[e];
+			if ( !done[v] and (*cost)[u] + this->adj_len[e] < (*cost)[v] )
+			{
+				(*cost)[v] = (*cost)[u] + this->adj_len[e];
+				(*toward)[v] = u;
+				open.push( { (*cost)[v], v } );
+			}
+		}
+	}
+}
+
+template <class T>
+list< CPairT<T> > CVisibilityGraphT<T>::FindPath( CPairT<T> start, CPairT<T> goal, vector<double> * cost, vector<int> * toward )
+/* The shortest route from 'start' to 'goal' over a tree 'Tree' has built toward 'goal': straight to the
+ * corner 'start' sees that minimises the distance to it plus the corner's 'cost', then along 'toward'.
+ * The corners are tried in increasing order of that sum, so the first one seen is the best.
+ * Returns the direct segment if there is no route. */
+{
+	vector< pair<double,int> > order;
+	greater< pair<double,int> > later;
+
+	if ( this->Visible( start, goal ) )
+		return {start, goal};
+
+	for ( int v = 0; v < this->num; v ++ )
+	{
+		if ( (*cost)[v] < HUGE_VAL )
+			order.push_back( { SegLen( start, this->Node(v) ) + (*cost)[v], v } );
+	}
+	make_heap( order.begin(), order.end(), later );
+	int first = -1;
+	while ( !order.empty() and first < 0 )
+	{
+		int v = order.front().second;
+		pop_heap( order.begin(), order.end(), later );
+		order.pop_back();
+		if ( this->Tangent( v, start ) and this->Visible( start, this->Node(v) ) )
+			first = v;
+	}
+	if ( first < 0 )
+		return {start, goal};
+
+	list< CPairT<T> > route = { start };
+	for ( int v = first; v >= 0; v = (*toward)[v] )
+	{
+		CPairT<T>	corner = this->Node(v),
+				after = ( (*toward)[v] >= 0 ? this->Node( (*toward)[v] ) : goal );
+		// mark the side so that 'OptimizePath' does not try to cut through the corner
+		bool	left_turn = OrientSign( route.back(), corner, after ) > 0;
+		corner.SetOnObstacle(true);
+		corner.SetClockwise( not left_turn );
+		corner.SetSide( left_turn ? RIGHT : LEFT );
+		route.push_back(corner);
+	}
+	route.push_back(goal);
+	return route;
+}
+
+size_t NavAlign( size_t bytes )
+{
+	return ( bytes + 7 ) & ~(size_t)7;
+}
+
+unsigned long long NavChecksum( const void * data, size_t bytes )
+/* The last word is padded with zeros, as it is in a navigation file. */
+{
+	const unsigned char * p = (const unsigned char *)data;
+	unsigned long long hash = 0xcbf29ce484222325ULL, word;
+	for ( size_t i = 0; i < bytes; i += 8 )
+	{
+		word = 0;
+		memcpy( &word, p + i, min( (size_t)8, bytes - i ) );
+		hash = ( hash ^ word ) * 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+template <class T>
+static unsigned int NavCoords(void)
+{
+	return sizeof(T) + ( numeric_limits<T>::is_integer ? 256 : 0 );
+}
+
+template <class T>
+unsigned long long SceneHash( CObstacleIndexT<T> * index )
+/* Covers the coordinate type and, for each obstacle number, whether it is live and its vertices,
+ * so that a graph is only ever loaded over the obstacles it was built over (numbered the same way). */
+{
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	auto Mix = [&hash]( unsigned long long word ) { hash = ( hash ^ word ) * 0x100000001b3ULL; };
+	Mix( NavCoords<T>() );
+	Mix( index->size() );
+	for ( unsigned int n = 0; n < index->size(); n ++ )
+	{
+		CObstacleT<T> * obstacle = index->Obstacle(n);
+		if ( !obstacle )
+		{
+			Mix( ~0ULL );
+			continue;
+		}
+		SPtsViewT<T> pts = obstacle->Pts();
+		Mix( pts.n );
+		for ( unsigned int i = 0; i < pts.n; i ++ )
+		{
+			unsigned long long x = 0, y = 0;
+			memcpy( &x, pts.x + i, sizeof(T) );
+			memcpy( &y, pts.y + i, sizeof(T) );
+			Mix(x), Mix(y);
+		}
+	}
+	return hash;
+}
+
+template <class T>
+CVisibilityGraphT<T> * CVisibilityGraphT<T>::Load( string path, CObstacleIndexT<T> * index )
+/* Checks everything before trusting any of it: the header and its checksum, the coordinate type,
+ * the scene hash against 'index', the file size, the checksum of every array, that the obstacle sizes
+ * are those of the obstacles (which every vertex lookup relies on) and leave room for the nodes,
+ * and that the edges stay within the nodes. The arrays are then used where they lie in the mapping. */
+{
+	int fd = open( path.c_str(), O_RDONLY );
+	if ( fd < 0 )
+		return 0;
+	struct stat info;
+	if ( fstat( fd, &info ) != 0 or info.st_size < (off_t)sizeof(SNavHeader) )
+	{
+		close(fd);
+		return 0;
+	}
+	size_t size = info.st_size;
+	void * map = mmap( 0, size, PROT_READ, MAP_SHARED, fd, 0 );
+	close(fd);
+	if ( map == MAP_FAILED )
+		return 0;
+
+	const SNavHeader * header = (const SNavHeader *)map;
+	size_t	bytes[NAV_SECTIONS] = { 4 * (size_t)header->obstacles, 6 * sizeof(T) * (size_t)header->nodes,
+									4 * ( (size_t)header->nodes + 1 ), 4 * (size_t)header->edges,
+									sizeof(typename SCoord<T>::real) * (size_t)header->edges },
+			total = sizeof(SNavHeader);
+	for ( size_t b : bytes )
+		total += NavAlign(b);
+	bool ok = ( memcmp( header->magic, NAV_MAGIC, sizeof(NAV_MAGIC) ) == 0 and header->version == NAV_VERSION
+				and header->check == NavChecksum( header, offsetof( SNavHeader, check ) )
+				and header->coords == NavCoords<T>() and header->obstacles == index->size() and size == total
+				and header->scene == SceneHash(index) );
+	const char * section = (const char *)( header + 1 );
+	for ( int k = 0; ok and k < NAV_SECTIONS; section += NavAlign( bytes[k] ), k ++ )
+		ok = ( header->sums[k] == NavChecksum( section, bytes[k] ) );
+
+	CVisibilityGraphT<T> * graph = ( ok ? new CVisibilityGraphT<T>( index, map, size ) : 0 );
+	if ( graph )
+	{
+		long long corners = 0;
+		for ( unsigned int n = 0; ok and n < index->size(); n ++ )
+		{
+			ok = ( graph->sizes[n] == Size( index->Obstacle(n) ) );
+			corners += graph->sizes[n];
+		}
+		ok = ( ok and graph->num <= corners );
+		ok = ( ok and graph->adj_start[0] == 0 and graph->adj_start[graph->num] == (int)graph->num_adj );
+		for ( int i = 0; ok and i < graph->num; i ++ )
+			ok = ( graph->adj_start[i] <= graph->adj_start[i+1] );
+		for ( unsigned int e = 0; ok and e < graph->num_adj; e ++ )
+			ok = ( graph->adj[e] >= 0 and graph->adj[e] < graph->num );
+		if ( !ok )
+			delete graph, graph = 0, map = 0; // the graph unmapped it
+	}
+	if ( !ok and map )
+		munmap( map, size );
+	return graph;
+}
+
+template <class T>
+bool CVisibilityGraphT<T>::Save( string path )
+/* Writes a temporary file beside 'path' and renames it into place, so that processes
+ * that have the old file mapped go on seeing it whole. The temporary file has a name of its own
+ * (from 'mkstemp'), so processes saving at the same time each rename a whole file of their own;
+ * it is synced before the rename, so a crash cannot leave 'path' half written either. */
+{
+	SNavHeader header;
+	const void * data[NAV_SECTIONS] = { this->sizes, this->corners, this->adj_start, this->adj, this->adj_len };
+	size_t bytes[NAV_SECTIONS] = { 4 * (size_t)this->index->size(), 6 * sizeof(T) * (size_t)this->num,
+								   4 * ( (size_t)this->num + 1 ), 4 * (size_t)this->num_adj,
+								   sizeof(typename SCoord<T>::real) * (size_t)this->num_adj };
+	char zeros[8] = { 0 };
+
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, NAV_MAGIC, sizeof(NAV_MAGIC) );
+	header.version = NAV_VERSION;
+	header.coords = NavCoords<T>();
+	header.scene = SceneHash( this->index );
+	header.obstacles = this->index->size();
+	header.nodes = this->num;
+	header.edges = this->num_adj;
+	for ( int k = 0; k < NAV_SECTIONS; k ++ )
+		header.sums[k] = NavChecksum( data[k], bytes[k] );
+	header.check = NavChecksum( &header, offsetof( SNavHeader, check ) );
+
+	vector<char> temp( path.begin(), path.end() );
+	temp.insert( temp.end(), ".XXXXXX", ".XXXXXX" + sizeof(".XXXXXX") );
+	int fd = mkstemp( temp.data() );
+	if ( fd < 0 )
+		return false;
+	FILE * file = fdopen( fd, "wb" );
+	if ( !file )
+	{
+		close(fd);
+		remove( temp.data() );
+		return false;
+	}
+	bool ok = ( fchmod( fd, 0644 ) == 0 and fwrite( &header, sizeof(header), 1, file ) == 1 );	// 'mkstemp' makes it private
+	for ( int k = 0; ok and k < NAV_SECTIONS; k ++ )
+	{
+		size_t pad = NavAlign( bytes[k] ) - bytes[k];
+		ok = ( fwrite( data[k], 1, bytes[k], file ) == bytes[k] and fwrite( zeros, 1, pad, file ) == pad );
+	}
+	ok = ( ok and fflush(file) == 0 and fsync(fd) == 0 );
+	ok = ( fclose(file) == 0 and ok );
+	if ( ok and rename( temp.data(), path.c_str() ) == 0 )
+		return true;
+	remove( temp.data() );
+	return false;
+}
+
+template <class T>
+CSceneT<T>::CSceneT( list< CObstacleT<T> > * obstacles )
+{
+	this->obstacles = *obstacles;
+	for ( typename list< CObstacleT<T> >::iterator it = this->obstacles.begin(); it != this->obstacles.end(); it ++ )
+		this->slots.push_back(it);
+	this->index = new CObstacleIndexT<T>( &this->obstacles );
+	this->graph = 0;
+	this->version = 0;
+	this->changes_base = 0;
+}
+
+template <class T>
+CSceneT<T>::~CSceneT()
+{
+	delete this->graph;
+	delete this->index;
+}
+
+template <class T>
+list< CObstacleT<T> > * CSceneT<T>::Obstacles(void)
+{
+	return &this->obstacles;
+}
+
+template <class T>
+CObstacleIndexT<T> * CSceneT<T>::Index(void)
+{
+	return this->index;
+}
+
+template <class T>
+CVisibilityGraphT<T> * CSceneT<T>::Graph(void)
+{
+	if ( !this->graph )
+		this->graph = new CVisibilityGraphT<T>( this->index );
+	return this->graph;
+}
+
+template <class T>
+bool CSceneT<T>::LoadGraph( string path )
+{
+	CVisibilityGraphT<T> * graph = CVisibilityGraphT<T>::Load( path, this->index );
+	if ( !graph )
+		return false;
+	delete this->graph;
+	this->graph = graph;
+	return true;
+}
+
+template <class T>
+bool CSceneT<T>::SaveGraph( string path )
+{
+	return this->Graph()->Save(path);
+}
+
+template <class T>
+void CSceneT<T>::Prepare( ESolver solver )
+{
+	if ( solver == SOLVER_VISIBILITY )
+		this->Graph();
+}
+
+template <class T>
+bool CSceneT<T>::Prepared( ESolver solver )
+{
+	return ( solver != SOLVER_VISIBILITY or this->graph );
+}
+
+template <class T>
+unsigned long CSceneT<T>::Version(void)
+{
+	return this->version;
+}
+
+template <class T>
+bool CSceneT<T>::Changes( unsigned long since, vector<int> * numbers )
+/* Sets 'numbers' (sorted, each once) for whoever is to catch up with the scene as it was at version 'since'.
+ * Returns false if the scene no longer remembers that far back, and everything has to be looked at again. */
+{
+	numbers->clear();
+	if ( since < this->changes_base or since > this->version )
+		return false;
+	numbers->assign( this->changes.begin() + ( since - this->changes_base ), this->changes.end() );
+	sort( numbers->begin(), numbers->end() );
+	numbers->erase( unique( numbers->begin(), numbers->end() ), numbers->end() );
+	return true;
+}
+
+template <class T>
+void CSceneT<T>::Changed( int number )
+/* The visibility graph is dropped rather than patched: it is rebuilt on next use. */
+{
+	this->version ++;
+	this->changes.push_back(number);
+	if ( this->changes.size() > SCENE_CHANGES_MAX )
+	{
+		this->changes.erase( this->changes.begin(), this->changes.begin() + SCENE_CHANGES_MAX / 2 );
+		this->changes_base += SCENE_CHANGES_MAX / 2;
+	}
+	delete this->graph;
+	this->graph = 0;
+}
+
+template <class T>
+bool CSceneT<T>::Live( int number )
+/* Removed obstacles keep their slot (the iterator in it is dead), but drop out of the index. */
+{
+	return ( number >= 0 and number < (int)this->slots.size() and this->index->Obstacle(number) );
+}
+
+template <class T>
+int CSceneT<T>::Insert( CObstacleT<T> * obstacle, int * number )
+{
+	typename list< CObstacleT<T> >::iterator slot = this->obstacles.insert( this->obstacles.end(), *obstacle );
+	this->slots.push_back(slot);
+	int n = this->index->Insert( &*slot );
+	if ( number )
+		*number = n;
+	this->Changed(n);
+	return this->Repair( 0, &*slot );
+}
+
+template <class T>
+int CSceneT<T>::Update( int number, CObstacleT<T> * obstacle )
+{
+	if ( !this->Live(number) )
+		return -1;
+	CObstacleT<T> old = *this->slots[number];
+	*this->slots[number] = *obstacle;
+	this->index->Update(number);
+	this->Changed(number);
+	return this->Repair( &old, &*this->slots[number] );
+}
+
+template <class T>
+int CSceneT<T>::Remove( int number )
+/* The number is not reused. */
+{
+	if ( !this->Live(number) )
+		return -1;
+	typename list< CObstacleT<T> >::iterator slot = this->slots[number];
+	this->index->Remove(number);
+	this->Changed(number);
+	int repaired = this->Repair( &*slot, 0 );
+	this->obstacles.erase(slot);
+	return repaired;
+}
+
+template <class T>
+int CSceneT<T>::Track( SSegT<T> seg, float tolerance )
+{
+	STrackedRouteT<T> tracked;
+	tracked.seg = seg;
+	tracked.tolerance = tolerance;
+	tracked.route = FindRoute( seg, this, SOLVER_CIRCUMVENT, tolerance );
+	tracked.box = BoxOf(seg.start);
+	for ( CPairT<T> & pt : tracked.route )
+		tracked.box = BoxUnion( tracked.box, BoxOf(pt) );
+	tracked.box = BoxPad(tracked.box);
+	tracked.live = true;
+	this->routes.push_back(tracked);
+	return this->routes.size() - 1;
+}
+
+template <class T>
+list< CPairT<T> > * CSceneT<T>::Route( int route )
+{
+	return ( this->routes[route].live ? &this->routes[route].route : 0 );
+}
+
+template <class T>
+void CSceneT<T>::Untrack( int route )
+{
+	this->routes[route].live = false;
+	this->routes[route].route.clear();
+}
+
+template <class T>
+int CSceneT<T>::Repair( CObstacleT<T> * removed, CObstacleT<T> * added )
+/* Replans only the stretches of each tracked route that the change touches:
+ * the legs that now cross 'added', and the legs that may have gone round 'removed'
+ * (those its hull does not clear), each widened by a waypoint either side.
+ * The rest of the route, and every route whose box the change misses, is kept as it was. */
+{
+	CPathMemoT<T> memo;
+	CArena arena;
+	vector< CPairT<T> > pts;
+	vector<char> hit;
+	list< SIsectDataT<T> > isects;
+	int repaired = 0;
+
+	for ( STrackedRouteT<T> & tracked : this->routes )
+	{
+		if ( !tracked.live or tracked.route.size() < 2 )
+			continue;
+		if ( !( removed and BoxesOverlap( tracked.box, removed->Bounds() ) )
+			 and !( added and BoxesOverlap( tracked.box, added->Bounds() ) ) )
+			continue;
+
+		pts.assign( tracked.route.begin(), tracked.route.end() );
+		int legs = pts.size() - 1;
+		bool any = false;
+		hit.assign( legs, 0 );
+		for ( int i = 0; i < legs; i ++ )
+		{
+			SSegT<T> leg = { pts[i], pts[i+1] };
+			if ( removed and !removed->Misses(leg) )
+				hit[i] = 1;
+			else if ( added and BoxHitsSeg( added->Bounds(), leg ) )
+			{
+				hit[i] = ( ObstacleIntersection( leg, added, &isects, tracked.tolerance ) != 0 );
+				isects.clear();
+			}
+			any = any or hit[i];
+		}
+		if ( !any )
+			continue;
+
+		list< CPairT<T> > route;
+		int i = 0;
+		route.push_back( pts[0] );
+		while ( i < legs )
+		{
+			if ( !hit[i] and !( i + 1 < legs and hit[i+1] ) )
+			{
+				route.push_back( pts[++ i] );
+				continue;
+			}
+			// from waypoint 'i' (a leg before the first hit one, if there is one) to 'j' (a leg after the last)
+			int j = i + 1;
+			while ( j < legs and ( hit[j-1] or hit[j] ) )
+				j ++;
+			CArenaPathT<T> piece = FindPath( { pts[i], pts[j] }, this->index, 0, 0, &memo, &arena );
+			OptimizePath( &piece, this->index, tracked.tolerance, &memo, 0, &arena );
+			piece.pop_front();	// 'pts[i]' is already there
+			route.insert( route.end(), piece.begin(), piece.end() );
+			i = j;
+		}
+		tracked.route.swap(route);
+
+		tracked.box = BoxOf( pts[0] );
+		for ( CPairT<T> & pt : tracked.route )
+			tracked.box = BoxUnion( tracked.box, BoxOf(pt) );
+		tracked.box = BoxPad(tracked.box);
+		memo.clear();
+		arena.Release();
+		repaired ++;
+	}
+	return repaired;
+}
+
+template <class T>
+list< CPairT<T> > FindRoute( typename SSegArg<T>::type seg, CSceneT<T> * scene, ESolver solver, float tolerance, CPathMemoT<T> * memo, CArena * arena )
+/* Finds a route from 'seg.start' to 'seg.end' with the chosen engine:
+ * SOLVER_CIRCUMVENT runs 'FindPath' and then 'OptimizePath' (with 'tolerance'),
+ * SOLVER_VISIBILITY searches the visibility graph for the shortest route.
+ * 'memo' may carry over between queries on the same scene.
+ * The intermediate paths go to 'arena', which the caller may release once this returns.
+ * Once 'scene->Prepare(solver)' has been called, nothing shared is modified,
+ * so any number of threads may call this at once (each with its own memo and arena). */
+{
+	CStatsScope scope(seg);
+	double started = ( query_stats ? StatsMicros() : 0 ), now;
+	if ( solver == SOLVER_VISIBILITY )
+	{
+		list< CPairT<T> > route = scene->Graph()->FindPath(seg);
+		if ( query_stats )
+			query_stats->visibility_us += StatsMicros() - started;
+		return route;
+	}
+
+	CArenaPathT<T> route = FindPath( seg, scene->Index(), 0, 0, memo, arena );
+	if ( query_stats )
+		now = StatsMicros(), query_stats->findpath_us += now - started, started = now;
+	OptimizePath( &route, scene->Index(), tolerance, memo, 0, arena );
+	if ( query_stats )
+	{
+		query_stats->optimize_us += StatsMicros() - started;
+		query_stats->arena_bytes += arena->Capacity();
+	}
+	return list< CPairT<T> >( route.begin(), route.end() );
+}
+
+template <class T>
+list< CPairT<T> > FindRoute( typename SSegArg<T>::type seg, CSceneT<T> * scene, ESolver solver, float tolerance, CPathMemoT<T> * memo )
+{
+	CArena arena;
+	return FindRoute( seg, scene, solver, tolerance, memo, &arena );
+}
+
+template <class T>
+list< CPairT<T> > FindRoute( typename SSegArg<T>::type seg, CSceneT<T> * scene, ESolver solver, float tolerance )
+{
+	CPathMemoT<T> memo;
+	return FindRoute( seg, scene, solver, tolerance, &memo );
+}
+
+template <class T>
+list< CPairT<T> > FindRoute( typename SSegArg<T>::type seg, CSceneT<T> * scene, float tolerance, SBudget * budget, bool * optimized )
+/* Anytime 'FindRoute' with SOLVER_CIRCUMVENT: the route of 'FindPath' is the first valid one, and
+ * 'OptimizePath' then improves it for as long as 'budget' allows. 'optimized' is set to whether it got
+ * to the end, so that the route is the same as 'FindRoute' would give. 'FindPath' itself always runs
+ * to the end, as there is no valid route before it: the budget only bounds the time spent improving. */
+{
+	CStatsScope scope(seg);
+	double started = ( query_stats ? StatsMicros() : 0 ), now;
+	CPathMemoT<T> memo;
+	CArena arena;
+	CArenaPathT<T> route = FindPath( seg, scene->Index(), 0, 0, &memo, &arena );
+	if ( query_stats )
+		now = StatsMicros(), query_stats->findpath_us += now - started, started = now;
+	bool finished = OptimizePath( &route, scene->Index(), tolerance, &memo, 0, &arena, budget );
+	if ( optimized )
+		*optimized = finished;
+	if ( query_stats )
+	{
+		query_stats->optimize_us += StatsMicros() - started;
+		query_stats->arena_bytes += arena.Capacity();
+	}
+	return list< CPairT<T> >( route.begin(), route.end() );
+}
+
+
+/// Batch queries //////////////////////////////////////////////////////
+
+#define BATCH_BLOCK		16		// queries handed to a worker at a time
+#define BATCH_MEMO_MAX	65536	// a worker's memo is emptied when it grows past this many routes
+
+template <class T>
+vector< list< CPairT<T> > > FindRoutes( vector< SSegT<T> > * queries, CSceneT<T> * scene, ESolver solver, float tolerance, CThreadPool * pool )
+/* Answers every query of 'queries' against the one shared 'scene', spread over the workers of 'pool',
+ * and returns the routes in the order of the queries. Each worker keeps one memo for all the queries
+ * it answers, as the scene does not change in between, and one arena it releases after each query. */
+{
+	vector< list< CPairT<T> > > routes( queries->size() );
+	vector< CPathMemoT<T> > memos( pool->size() );
+	vector<CArena> arenas( pool->size() );
+	scene->Prepare(solver);
+
+	for ( unsigned int first = 0; first < queries->size(); first += BATCH_BLOCK )
+	{
+		unsigned int last = min( (unsigned int)queries->size(), first + BATCH_BLOCK );
+		pool->Submit( [=, &routes, &memos, &arenas]( int worker )
+			{
+				CPathMemoT<T> & memo = memos[worker];
+				for ( unsigned int q = first; q < last; q ++ )
+				{
+					if ( memo.size() > BATCH_MEMO_MAX )
+						memo.clear();
+					routes[q] = FindRoute( (*queries)[q], scene, solver, tolerance, &memo, &arenas[worker] );
+					arenas[worker].Release();
+				}
+			} );
+	}
+	pool->Wait();
+	return routes;
+}
+
+template <class T>
+vector< list< CPairT<T> > > FindRoutes( vector< SSegT<T> > * queries, CSceneT<T> * scene, ESolver solver, float tolerance )
+{
+	CThreadPool pool(0);
+	return FindRoutes( queries, scene, solver, tolerance, &pool );
+}
+
+
+/// Hierarchical planner ///////////////////////////////////////////////
+
+template <class T>
+CRegionMapT<T>::CRegionMapT( CSceneT<T> * scene, double side, float tolerance, CThreadPool * pool )
+{
+	double xmin = HUGE_VAL, ymin = HUGE_VAL, xmax = -HUGE_VAL, ymax = -HUGE_VAL;
+	for ( CObstacleT<T> & obstacle : *scene->Obstacles() )
+	{
+		SBoxT<T> box = obstacle.Bounds();
+		xmin = min( xmin, SCoord<T>::Value(box.xmin) ), ymin = min( ymin, SCoord<T>::Value(box.ymin) );
+		xmax = max( xmax, SCoord<T>::Value(box.xmax) ), ymax = max( ymax, SCoord<T>::Value(box.ymax) );
+	}
+	bool empty = ( xmin > xmax );
+	this->scene = scene;
+	this->version = scene->Version();
+	this->tolerance = tolerance;
+	this->side = side;
+	this->x0 = ( empty ? 0 : xmin );
+	this->y0 = ( empty ? 0 : ymin );
+	this->nx = ( empty ? 1 : max( 1, (int)ceil( (xmax - xmin) / side ) ) );
+	this->ny = ( empty ? 1 : max( 1, (int)ceil( (ymax - ymin) / side ) ) );
+	this->members.resize( this->nx * this->ny );
+
+	// the portals, tried from the middle of each shared side outwards
+	static const double spots[] = { 0.5, 0.25, 0.75, 0.125, 0.375, 0.625, 0.875 };
+	auto Portals = [&]( double ax, double ay, double dx, double dy, int region1, int region2 )
+	{
+		int kept = 0;
+		for ( double f : spots )
+		{
+			CPair pt( SCoord<T>::From( ax + f * dx ), SCoord<T>::From( ay + f * dy ) );
+			if ( kept == REGION_PORTALS or !this->Free(pt) )
+				continue;
+			this->members[region1].push_back( this->portals.size() );
+			this->members[region2].push_back( this->portals.size() );
+			this->portals.push_back(pt);
+			kept ++;
+		}
+	};
+	for ( int j = 0; j < this->ny; j ++ )
+	{
+		for ( int i = 0; i < this->nx; i ++ )
+		{
+			if ( i + 1 < this->nx )
+				Portals( this->x0 + (i + 1) * side, this->y0 + j * side, 0, side, j * this->nx + i, j * this->nx + i + 1 );
+			if ( j + 1 < this->ny )
+				Portals( this->x0 + i * side, this->y0 + (j + 1) * side, side, 0, j * this->nx + i, (j + 1) * this->nx + i );
+		}
+	}
+
+	// the routes between the portals of each region (a pair sharing two regions is planned once)
+	vector< pair<int,int> > pairs;
+	for ( vector<int> & portals : this->members )
+	{
+		for ( unsigned int a = 0; a < portals.size(); a ++ )
+			for ( unsigned int b = a + 1; b < portals.size(); b ++ )
+				pairs.push_back( { min( portals[a], portals[b] ), max( portals[a], portals[b] ) } );
+	}
+	sort( pairs.begin(), pairs.end() );
+	pairs.erase( unique( pairs.begin(), pairs.end() ), pairs.end() );
+	vector<SSeg> queries;
+	for ( pair<int,int> & ends : pairs )
+	{
+		queries.push_back( { this->portals[ends.first], this->portals[ends.second] } );
+		this->route_from.push_back( ends.first );
+	}
+	this->routes = ( pool ? FindRoutes( &queries, scene, SOLVER_CIRCUMVENT, tolerance, pool )
+						  : FindRoutes( &queries, scene, SOLVER_CIRCUMVENT, tolerance ) );
+
+	// and the graph they make
+	int num = this->portals.size();
+	this->adj_start.assign( num + 1, 0 );
+	for ( pair<int,int> & ends : pairs )
+		this->adj_start[ ends.first + 1 ] ++, this->adj_start[ ends.second + 1 ] ++;
+	for ( int i = 0; i < num; i ++ )
+		this->adj_start[i+1] += this->adj_start[i];
+	vector<int> next( this->adj_start.begin(), this->adj_start.end() - 1 );
+	this->adj.resize( 2 * pairs.size() );
+	this->adj_route.resize( 2 * pairs.size() );
+	this->adj_len.resize( 2 * pairs.size() );
+	for ( unsigned int r = 0; r < pairs.size(); r ++ )
+	{
+		typename SCoord<T>::real len = PathLen( &this->routes[r] );
+		int ends[2] = { pairs[r].first, pairs[r].second };
+		for ( int k = 0; k < 2; k ++ )
+		{
+			int e = next[ ends[k] ] ++;
+			this->adj[e] = ends[1-k], this->adj_route[e] = r, this->adj_len[e] = len;
+		}
+	}
+}
+
+template <class T>
+unsigned int CRegionMapT<T>::size(void)
+{
+	return this->portals.size();
+}
+
+template <class T>
+unsigned int CRegionMapT<T>::Routes(void)
+{
+	return this->routes.size();
+}
+
+template <class T>
+int CRegionMapT<T>::Region( CPairT<T> pt, int * i, int * j )
+{
+	*i = min( this->nx - 1, max( 0, (int)floor( ( SCoord<T>::Value( pt.GetX() ) - this->x0 ) / this->side ) ) );
+	*j = min( this->ny - 1, max( 0, (int)floor( ( SCoord<T>::Value( pt.GetY() ) - this->y0 ) / this->side ) ) );
+	return *j * this->nx + *i;
+}
+
+template <class T>
+bool CRegionMapT<T>::Free( CPairT<T> pt )
+{
+	vector<int> hits;
+	return ( this->scene->Index()->Candidates( {pt, pt}, &hits ) == 0 );
+}
+
+template <class T>
+void CRegionMapT<T>::Append( list< CPairT<T> > * route, int r, int from )
+/* Walked backwards, a route passes every corner on the other side and the other way round. */
+{
+	list<CPair> & piece = this->routes[r];
+	if ( this->route_from[r] == from )
+	{
+		route->insert( route->end(), ++ piece.begin(), piece.end() );
+		return;
+	}
+	for ( typename list<CPair>::reverse_iterator it = ++ piece.rbegin(); it != piece.rend(); ++ it )
+	{
+		CPair corner = *it;
+		if ( corner.GetOnObstacle() )
+		{
+			corner.SetClockwise( not corner.GetClockwise() );
+			corner.SetSide( not corner.GetSide() );
+		}
+		route->push_back(corner);
+	}
+}
+
+template <class T>
+list< CPairT<T> > CRegionMapT<T>::FindPath( SSegT<T> seg )
+/* A* over the portals, with the straight-line distance to 'seg.end' as the heuristic
+ * (the legs to and from the end points are reckoned as straight lines too). */
+{
+	CPathMemoT<T> memo;
+	int si, sj, gi, gj, from = this->Region( seg.start, &si, &sj ), to = this->Region( seg.end, &gi, &gj );
+	if ( this->scene->Version() != this->version or ( abs(si - gi) <= 1 and abs(sj - gj) <= 1 ) )
+		return ::FindRoute( seg, this->scene, SOLVER_CIRCUMVENT, this->tolerance, &memo );
+
+	int		num = this->portals.size(), start = num, goal = num + 1;
+	vector<double> cost( num + 2, HUGE_VAL );
+	vector<int> parent( num + 2, -1 ), through( num + 2, -1 );
+	vector<char> done( num + 2, 0 ), exits( num, 0 );
+	priority_queue< pair<double,int>, vector< pair<double,int> >, greater< pair<double,int> > > open;
+	for ( int p : this->members[to] )
+		exits[p] = 1;
+
+	auto Position = [&]( int i ) { return ( i == start ? seg.start : ( i == goal ? seg.end : this->portals[i] ) ); };
+	auto Relax = [&]( int u, int v, double len, int r )
+	{
+		if ( cost[u] + len < cost[v] )
+		{
+			cost[v] = cost[u] + len;
+			parent[v] = u;
+			through[v] = r;
+			open.push( { cost[v] + SegLen( Position(v), seg.end ), v } );
+		}
+	};
+
+	cost[start] = 0;
+	open.push( { SegLen( seg.start, seg.end ), start } );
+	while ( !open.empty() )
+	{
+		int u = open.top().second;
+		open.pop();
+		if ( done[u] )
+			continue;
+		done[u] = 1;
+		if ( u == goal )
+			break;
+
+		if ( u == start )
+		{
+			for ( int v : this->members[from] )
+				Relax( u, v, SegLen( seg.start, this->portals[v] ), -1 );
+			continue;
+		}
+		for ( int e = this->adj_start[u]; e < this->adj_start[u+1]; e ++ )
+		{
+			if ( !done[ this->adj[e] ] )
+				Relax( u, this->adj[e], this->adj_len[e], this->adj_route[e] );
+		}
+		if ( exits[u] )
+			Relax( u, goal, SegLen( this->portals[u], seg.end ), -1 );
+	}
+	if ( parent[goal] < 0 )
+		return ::FindRoute( seg, this->scene, SOLVER_CIRCUMVENT, this->tolerance, &memo );
+
+	vector<int> via;
+	for ( int v = parent[goal]; v != start; v = parent[v] )
+		via.push_back(v);
+	reverse( via.begin(), via.end() );
+
+	// the legs at the ends, and the planned routes between them
+	list<CPair> route = ::FindRoute( SSeg{ seg.start, this->portals[via.front()] }, this->scene, SOLVER_CIRCUMVENT, this->tolerance, &memo );
+	vector<typename list<CPair>::iterator> joins;
+	for ( unsigned int k = 0; k < via.size(); k ++ )
+	{
+		joins.push_back( -- route.end() );
+		if ( k + 1 < via.size() )
+			this->Append( &route, through[ via[k+1] ], via[k] );
+	}
+	list<CPair> last = ::FindRoute( SSeg{ this->portals[via.back()], seg.end }, this->scene, SOLVER_CIRCUMVENT, this->tolerance, &memo );
+	route.insert( route.end(), ++ last.begin(), last.end() );
+
+	// a portal is only a way through: mark it to be cut whichever way the route turns there
+	for ( typename list<CPair>::iterator join : joins )
+	{
+		typename list<CPair>::iterator before = prev(join), after = next(join);
+		join->SetSide(LEFT);
+		if ( !CornerCuttable( *before, *join, *after ) )
+			join->SetSide(RIGHT);
+	}
+	OptimizePath( &route, this->scene->Index(), this->tolerance, &memo );
+	return route;
+}
+
+template <class T>
+list< CPairT<T> > FindRoute( typename SSegArg<T>::type seg, CRegionMapT<T> * regions )
+{
+	CStatsScope scope(seg);
+	return regions->FindPath(seg);
+}
+
+/// Occupancy grid /////////////////////////////////////////////////////
+
+template <class T>
+CGridMapT<T>::CGridMapT( CSceneT<T> * scene, double cell, float tolerance )
+{
+	double xmin = HUGE_VAL, ymin = HUGE_VAL, xmax = -HUGE_VAL, ymax = -HUGE_VAL;
+	for ( CObstacleT<T> & obstacle : *scene->Obstacles() )
+	{
+		SBoxT<T> box = obstacle.Bounds();
+		xmin = min( xmin, SCoord<T>::Value(box.xmin) ), ymin = min( ymin, SCoord<T>::Value(box.ymin) );
+		xmax = max( xmax, SCoord<T>::Value(box.xmax) ), ymax = max( ymax, SCoord<T>::Value(box.ymax) );
+	}
+	if ( xmin > xmax )
+		xmin = ymin = xmax = ymax = 0;
+	this->scene = scene;
+	this->tolerance = tolerance;
+	this->cell = cell;
+	this->x0 = xmin - GRID_MARGIN * cell;
+	this->y0 = ymin - GRID_MARGIN * cell;
+	this->nx = max( 1, (int)ceil( (xmax - xmin) / cell ) ) + 2 * GRID_MARGIN;
+	this->ny = max( 1, (int)ceil( (ymax - ymin) / cell ) ) + 2 * GRID_MARGIN;
+	this->words = ( this->nx + 63 ) / 64;
+	this->twords = ( this->ny + 63 ) / 64;
+	this->bits.assign( this->words * this->ny, 0 );
+	this->tbits.assign( this->twords * this->nx, 0 );
+	this->cover.assign( this->nx * this->ny, 0 );
+	for ( int y = 0; y < this->ny; y ++ )	// the bits past the end of each row count as blocked
+		for ( int x = this->nx; x < 64 * this->words; x ++ )
+			this->bits[ y * this->words + x / 64 ] |= 1ULL << ( x % 64 );
+	for ( int x = 0; x < this->nx; x ++ )
+		for ( int y = this->ny; y < 64 * this->twords; y ++ )
+			this->tbits[ x * this->twords + y / 64 ] |= 1ULL << ( y % 64 );
+
+	CObstacleIndexT<T> * index = scene->Index();
+	this->cells.resize( index->size() );
+	for ( unsigned int n = 0; n < index->size(); n ++ )
+	{
+		if ( index->Obstacle(n) )
+			this->Rasterize( index->Obstacle(n), &this->cells[n] ), this->Cover( n, 1 );
+	}
+	this->version = scene->Version();
+}
+
+template <class T>
+int CGridMapT<T>::Width(void)
+{
+	return this->nx;
+}
+
+template <class T>
+int CGridMapT<T>::Height(void)
+{
+	return this->ny;
+}
+
+template <class T>
+unsigned int CGridMapT<T>::Blocked(void)
+{
+	unsigned int blocked = 0;
+	for ( unsigned short count : this->cover )
+		blocked += ( count > 0 );
+	return blocked;
+}
+
+template <class T>
+void CGridMapT<T>::Rasterize( CObstacleT<T> * obstacle, vector<unsigned int> * cells )
+/* Sets 'cells' to those the obstacle touches: the cells its edges pass through (a corner passed exactly
+ * counts both cells beside it), and those whose centres lie inside it. Cells off the grid are left out. */
+{
+	SPtsViewT<T> pts = obstacle->Pts();
+	int n = pts.n;
+	vector<double> gx(n), gy(n);
+	for ( int i = 0; i < n; i ++ )
+	{
+		gx[i] = ( SCoord<T>::Value( pts.x[i] ) - this->x0 ) / this->cell;
+		gy[i] = ( SCoord<T>::Value( pts.y[i] ) - this->y0 ) / this->cell;
+	}
+	auto Add = [&]( int x, int y )
+	{
+		if ( x >= 0 and x < this->nx and y >= 0 and y < this->ny )
+			cells->push_back( y * this->nx + x );
+	};
+
+	// the edges, walked cell by cell (closing the polygon, if its first point is not repeated)
+	for ( int i = 0; i < n; i ++ )
+	{
+		int		j = ( i + 1 ) % n,
+				x = floor( gx[i] ), y = floor( gy[i] ),
+				ex = floor( gx[j] ), ey = floor( gy[j] ),
+				steps = abs( ex - x ) + abs( ey - y );
+		double	dx = gx[j] - gx[i], dy = gy[j] - gy[i];
+		int		sx = ( dx > 0 ? 1 : -1 ), sy = ( dy > 0 ? 1 : -1 );
+		double	tx = ( dx != 0 ? ( x + ( dx > 0 ) - gx[i] ) / dx : HUGE_VAL ),
+				ty = ( dy != 0 ? ( y + ( dy > 0 ) - gy[i] ) / dy : HUGE_VAL ),
+				step_x = ( dx != 0 ? sx / dx : HUGE_VAL ),
+				step_y = ( dy != 0 ? sy / dy : HUGE_VAL );
+		Add( x, y );
+		for ( int k = 0; k < steps; k ++ )
+		{
+			if ( tx < ty )
+				x += sx, tx += step_x;
+			else if ( ty < tx )
+				y += sy, ty += step_y;
+			else
+			{
+				Add( x + sx, y ), Add( x, y + sy );
+				x += sx, y += sy, tx += step_x, ty += step_y, k ++;
+			}
+			Add( x, y );
+		}
+		Add( ex, ey );
+	}
+
+	// the inside, row by row
+	double ymin = HUGE_VAL, ymax = -HUGE_VAL;
+	for ( int i = 0; i < n; i ++ )
+		ymin = min( ymin, gy[i] ), ymax = max( ymax, gy[i] );
+	vector<double> xs;
+	for ( int row = max( 0, (int)floor(ymin) ); row <= min( this->ny - 1, (int)floor(ymax) ); row ++ )
+	{
+		double yc = row + 0.5;
+		xs.clear();
+		for ( int i = 0; i < n; i ++ )
+		{
+			int j = ( i + 1 ) % n;
+			if ( ( gy[i] <= yc ) != ( gy[j] <= yc ) )
+				xs.push_back( gx[i] + ( yc - gy[i] ) * ( gx[j] - gx[i] ) / ( gy[j] - gy[i] ) );
+		}
+		sort( xs.begin(), xs.end() );
+		for ( unsigned int k = 0; k + 1 < xs.size(); k += 2 )
+		{
+			for ( int x = max( 0, (int)ceil( xs[k] - 0.5 ) ); x <= min( this->nx - 1, (int)floor( xs[k+1] - 0.5 ) ); x ++ )
+				Add( x, row );
+		}
+	}
+	sort( cells->begin(), cells->end() );
+	cells->erase( unique( cells->begin(), cells->end() ), cells->end() );
+}
+
+template <class T>
+void CGridMapT<T>::Cover( int number, int delta )
+{
+	for ( unsigned int c : this->cells[number] )
+	{
+		int x = c % this->nx, y = c / this->nx;
+		this->cover[c] += delta;
+		unsigned long long	& word = this->bits[ y * this->words + x / 64 ], bit = 1ULL << ( x % 64 ),
+							& tword = this->tbits[ x * this->twords + y / 64 ], tbit = 1ULL << ( y % 64 );
+		word = ( this->cover[c] ? word | bit : word & ~bit );
+		tword = ( this->cover[c] ? tword | tbit : tword & ~tbit );
+	}
+}
+
+template <class T>
+int CGridMapT<T>::Refresh(void)
+/* Only the obstacles the scene reports changed are rasterized again (all of them, if it has forgotten).
+ * Obstacles that now reach beyond the grid are cut off at its border, beyond which everything counts as blocked. */
+{
+	if ( this->scene->Version() == this->version )
+		return 0;
+	CObstacleIndexT<T> * index = this->scene->Index();
+	vector<int> numbers;
+	if ( !this->scene->Changes( this->version, &numbers ) )
+	{
+		numbers.clear();
+		for ( unsigned int n = 0; n < index->size(); n ++ )
+			numbers.push_back(n);
+	}
+	if ( this->cells.size() < index->size() )
+		this->cells.resize( index->size() );
+	for ( int n : numbers )
+	{
+		this->Cover( n, -1 );
+		this->cells[n].clear();
+		if ( index->Obstacle(n) )
+			this->Rasterize( index->Obstacle(n), &this->cells[n] ), this->Cover( n, 1 );
+	}
+	this->version = this->scene->Version();
+	return numbers.size();
+}
+
+template <class T>
+bool CGridMapT<T>::Free( int x, int y )
+{
+	return ( x >= 0 and x < this->nx and y >= 0 and y < this->ny
+			 and !( this->bits[ y * this->words + x / 64 ] >> ( x % 64 ) & 1 ) );
+}
+
+template <class T>
+CPairT<T> CGridMapT<T>::Centre( int x, int y )
+{
+	return CPair( SCoord<T>::From( this->x0 + ( x + 0.5 ) * this->cell ), SCoord<T>::From( this->y0 + ( y + 0.5 ) * this->cell ) );
+}
+
+template <class T>
+bool CGridMapT<T>::Snap( CPairT<T> pt, int * x, int * y )
+{
+	double	px = ( SCoord<T>::Value( pt.GetX() ) - this->x0 ) / this->cell,
+			py = ( SCoord<T>::Value( pt.GetY() ) - this->y0 ) / this->cell,
+			best = HUGE_VAL;
+	int cx = floor(px), cy = floor(py);
+	if ( cx < 0 or cx >= this->nx or cy < 0 or cy >= this->ny )
+		return false;
+	for ( int ring = 0; ring <= GRID_SNAP_RINGS and best == HUGE_VAL; ring ++ )
+	{
+		for ( int j = cy - ring; j <= cy + ring; j ++ )
+		{
+			for ( int i = cx - ring; i <= cx + ring; i ++ )
+			{
+				double d = ( i + 0.5 - px ) * ( i + 0.5 - px ) + ( j + 0.5 - py ) * ( j + 0.5 - py );
+				if ( ( abs(i - cx) == ring or abs(j - cy) == ring ) and this->Free( i, j ) and d < best )
+					best = d, *x = i, *y = j;
+			}
+		}
+	}
+	return ( best < HUGE_VAL );
+}
+
+template <class T>
+int CGridMapT<T>::Line( vector<unsigned long long> * lines, int words, int count, int line, int pos, int dir, int goal )
+/* A straight jump along row (or column) 'line' of 'lines', from 'pos' in the direction 'dir' (+1 or -1),
+ * 64 cells at a time: the blocked cells and those beside a wall that ends are found with bit operations.
+ * Returns where the jump ends (at 'goal', the goal's position if it lies on this line, or a jump point),
+ * or -1 if it runs into a blocked cell first. */
+{
+	auto Window = [&]( int l, int start )	// the 64 bits from cell 'start' on
+	{
+		auto Word = [&]( int k ) { return ( k < 0 or k >= words ? ~0ULL : (*lines)[ l * words + k ] ); };
+		if ( l < 0 or l >= count )
+			return ~0ULL;
+		int k = ( start >= 0 ? start / 64 : -( ( 63 - start ) / 64 ) ), shift = start - 64 * k;
+		return ( shift ? Word(k) >> shift | Word(k + 1) << ( 64 - shift ) : Word(k) );
+	};
+	while ( true )
+	{
+		if ( dir > 0 )
+		{
+			unsigned long long	b = Window( line, pos ), u = Window( line + 1, pos ), d = Window( line - 1, pos ),
+								stop = ( b | ( ~u & u << 1 ) | ( ~d & d << 1 ) ) & ~1ULL;
+			int i = ( stop ? __builtin_ctzll(stop) : 63 );
+			if ( goal > pos and goal <= pos + i )
+				return goal;
+			if ( stop )
+				return ( b >> i & 1 ? -1 : pos + i );
+			pos += 63;
+		}
+		else
+		{
+			unsigned long long	b = Window( line, pos - 63 ), u = Window( line + 1, pos - 63 ), d = Window( line - 1, pos - 63 ),
+								stop = ( b | ( ~u & u >> 1 ) | ( ~d & d >> 1 ) ) & ~( 1ULL << 63 );
+			int i = ( stop ? 63 - __builtin_clzll(stop) : 0 );
+			if ( goal >= 0 and goal < pos and goal >= pos - 63 + i )
+				return goal;
+			if ( stop )
+				return ( b >> i & 1 ? -1 : pos - 63 + i );
+			pos -= 63;
+		}
+	}
+}
+
+template <class T>
+bool CGridMapT<T>::Jump( int x, int y, int dx, int dy, int gx, int gy, int * jx, int * jy )
+/* Goes from (x,y) in the direction (dx,dy) to the next jump point: the goal, or a cell with a neighbour
+ * that only a route through it reaches best. Returns false if the way is blocked first. */
+{
+	if ( !dy or !dx )
+	{
+		int end = ( !dy ? this->Line( &this->bits, this->words, this->ny, y, x, dx, y == gy ? gx : -1 )
+						: this->Line( &this->tbits, this->twords, this->nx, x, y, dy, x == gx ? gy : -1 ) );
+		if ( end < 0 )
+			return false;
+		*jx = ( !dy ? end : x ), *jy = ( !dy ? y : end );
+		return true;
+	}
+	while ( true )
+	{
+		x += dx, y += dy;
+		if ( !this->Free( x, y ) or !this->Free( x - dx, y ) or !this->Free( x, y - dy ) )
+			return false;
+		if ( ( x == gx and y == gy )
+			 or this->Line( &this->bits, this->words, this->ny, y, x, dx, y == gy ? gx : -1 ) >= 0
+			 or this->Line( &this->tbits, this->twords, this->nx, x, y, dy, x == gx ? gy : -1 ) >= 0 )
+			break;
+	}
+	*jx = x, *jy = y;
+	return true;
+}
+
+template <class T>
+list< CPairT<T> > CGridMapT<T>::FindPath( SSegT<T> seg )
+/* A* over the jump points, with the octile distance as the heuristic. An end point in a blocked cell
+ * is joined to the nearest free one by 'FindRoute'; one with none nearby, or off the grid, sends the query there. */
+{
+	CPathMemoT<T> memo;
+	int sx, sy, gx, gy;
+	if ( this->scene->Version() != this->version or !this->Snap( seg.start, &sx, &sy ) or !this->Snap( seg.end, &gx, &gy ) )
+		return ::FindRoute( seg, this->scene, SOLVER_CIRCUMVENT, this->tolerance, &memo );
+
+	struct SJumpPoint
+	{
+		double cost;
+		int parent;
+		bool done;
+	};
+	unordered_map<int, SJumpPoint> points;
+	priority_queue< pair<double,int>, vector< pair<double,int> >, greater< pair<double,int> > > open;
+	auto Octile = [&]( int a, int b )
+	{
+		int dx = abs( a % this->nx - b % this->nx ), dy = abs( a / this->nx - b / this->nx );
+		return max( dx, dy ) + ( M_SQRT2 - 1 ) * min( dx, dy );
+	};
+	int start = sy * this->nx + sx, goal = gy * this->nx + gx;
+	points[start] = SJumpPoint{ 0, -1, false };
+	open.push( { Octile( start, goal ), start } );
+	while ( !open.empty() )
+	{
+		int u = open.top().second;
+		open.pop();
+		SJumpPoint & point = points[u];
+		if ( point.done )
+			continue;
+		point.done = true;
+		if ( u == goal )
+			break;
+
+		// the directions worth following, given the one the route came from
+		int x = u % this->nx, y = u / this->nx, dirs[8][2], num = 0;
+		if ( point.parent < 0 )
+		{
+			for ( int dy = -1; dy <= 1; dy ++ )
+				for ( int dx = -1; dx <= 1; dx ++ )
+					if ( dx or dy )
+						dirs[num][0] = dx, dirs[num][1] = dy, num ++;
+		}
+		else
+		{
+			int	dx = ( x > point.parent % this->nx ) - ( x < point.parent % this->nx ),
+				dy = ( y > point.parent / this->nx ) - ( y < point.parent / this->nx );
+			dirs[num][0] = dx, dirs[num][1] = dy, num ++;
+			if ( dx and dy )
+			{
+				dirs[num][0] = dx, dirs[num][1] = 0, num ++;
+				dirs[num][0] = 0, dirs[num][1] = dy, num ++;
+			}
+			for ( int side = -1; side <= 1; side += 2 )
+			{
+				if ( dx and !dy and this->Free( x, y + side ) and !this->Free( x - dx, y + side ) )
+				{
+					dirs[num][0] = 0, dirs[num][1] = side, num ++;
+					dirs[num][0] = dx, dirs[num][1] = side, num ++;
+				}
+				if ( dy and !dx and this->Free( x + side, y ) and !this->Free( x + side, y - dy ) )
+				{
+					dirs[num][0] = side, dirs[num][1] = 0, num ++;
+					dirs[num][0] = side, dirs[num][1] = dy, num ++;
+				}
+			}
+		}
+
+		double cost = point.cost;
+		for ( int d = 0; d < num; d ++ )
+		{
+			int jx, jy;
+			if ( !this->Jump( x, y, dirs[d][0], dirs[d][1], gx, gy, &jx, &jy ) )
+				continue;
+			int v = jy * this->nx + jx;
+			typename unordered_map<int, SJumpPoint>::iterator it = points.find(v);
+			double reached = cost + Octile( u, v );
+			if ( it == points.end() or ( !it->second.done and reached < it->second.cost ) )
+			{
+				points[v] = SJumpPoint{ reached, u, false };
+				open.push( { reached + Octile( v, goal ), v } );
+			}
+		}
+	}
+	if ( !points.count(goal) or !points[goal].done )
+		return ::FindRoute( seg, this->scene, SOLVER_CIRCUMVENT, this->tolerance, &memo );
+
+	// the centres of the jump points, between legs to the end points
+	list<CPair> centres;
+	for ( int v = goal; v >= 0; v = points[v].parent )
+		centres.push_front( this->Centre( v % this->nx, v / this->nx ) );
+	auto Leg = [&]( CPair from, CPair to, bool straight )
+	{
+		if ( straight )
+			return ( from == to ? list<CPair>{ from } : list<CPair>{ from, to } );
+		return ::FindRoute( SSeg{ from, to }, this->scene, SOLVER_CIRCUMVENT, this->tolerance, &memo );
+	};
+	auto Own = [&]( CPair pt, int x, int y )
+	{
+		return ( (int)floor( ( SCoord<T>::Value( pt.GetX() ) - this->x0 ) / this->cell ) == x
+				 and (int)floor( ( SCoord<T>::Value( pt.GetY() ) - this->y0 ) / this->cell ) == y );
+	};
+	list<CPair> route = Leg( seg.start, centres.front(), Own( seg.start, sx, sy ) ),
+				last = Leg( centres.back(), seg.end, Own( seg.end, gx, gy ) );
+	vector<typename list<CPair>::iterator> turns = { -- route.end() };
+	for ( typename list<CPair>::iterator it = ++ centres.begin(); it != centres.end(); ++ it )
+		turns.push_back( route.insert( route.end(), *it ) );
+	route.insert( route.end(), ++ last.begin(), last.end() );
+
+	// a cell centre is only a way through: mark it to be cut whichever way the route turns there
+	for ( typename list<CPair>::iterator turn : turns )
+	{
+		if ( turn == route.begin() or next(turn) == route.end() )
+			continue;
+		turn->SetSide(LEFT);
+		if ( !CornerCuttable( *prev(turn), *turn, *next(turn) ) )
+			turn->SetSide(RIGHT);
+	}
+	OptimizePath( &route, this->scene->Index(), this->tolerance, &memo );
+	return route;
+}
+
+template <class T>
+list< CPairT<T> > FindRoute( typename SSegArg<T>::type seg, CGridMapT<T> * grid )
+{
+	CStatsScope scope(seg);
+	return grid->FindPath(seg);
+}
+
+/// Route cache ////////////////////////////////////////////////////////
+
+template <class T>
+CRouteCacheT<T>::CRouteCacheT( CSceneT<T> * scene, unsigned int capacity, double step )
+{
+	this->scene = scene;
+	this->capacity = capacity;
+	this->step = step;
+	this->version = scene->Version();
+	memset( &this->stats, 0, sizeof(this->stats) );
+}
+
+template <class T>
+void CRouteCacheT<T>::Validate(void)
+{
+	if ( this->scene->Version() == this->version )
+		return;
+	this->stats.invalidated += this->entries.size();
+	this->entries.clear();
+	this->keys.clear();
+	this->version = this->scene->Version();
+}
+
+template <class T>
+SRouteKeyT<T> CRouteCacheT<T>::Key( SSegT<T> seg, ESolver solver, float tolerance )
+/* A whole query starts with the first obstacle. */
+{
+	return SRouteKeyT<T>{ CPathMemoT<T>::Key( seg, 0, tolerance ), solver };
+}
+
+template <class T>
+CSceneT<T> * CRouteCacheT<T>::Scene(void)
+{
+	return this->scene;
+}
+
+template <class T>
+SSegT<T> CRouteCacheT<T>::Snap( SSegT<T> seg )
+/* The end points come back plain (not on an obstacle), as the key of a query holds nothing else. */
+{
+	CPairT<T> * ends[2] = { &seg.start, &seg.end };
+	for ( CPairT<T> * end : ends )
+	{
+		T x = end->GetX(), y = end->GetY();
+		if ( this->step > 0 )
+		{
+			x = SCoord<T>::From( floor( SCoord<T>::Value(x) / this->step + 0.5 ) * this->step );
+			y = SCoord<T>::From( floor( SCoord<T>::Value(y) / this->step + 0.5 ) * this->step );
+		}
+		*end = CPairT<T>( x, y );
+	}
+	return seg;
+}
+
+template <class T>
+bool CRouteCacheT<T>::Find( SSegT<T> seg, ESolver solver, float tolerance, list< CPairT<T> > * route )
+{
+	lock_guard<mutex> hold( this->lock );
+	this->Validate();
+	typename unordered_map< SRouteKeyT<T>, typename TEntries::iterator, SRouteKeyHashT<T> >::iterator
+		it = this->keys.find( Key( seg, solver, tolerance ) );
+	if ( it == this->keys.end() )
+	{
+		this->stats.misses ++;
+		return false;
+	}
+	this->entries.splice( this->entries.begin(), this->entries, it->second );
+	*route = it->second->route;
+	this->stats.hits ++;
+	return true;
+}
+
+template <class T>
+void CRouteCacheT<T>::Store( SSegT<T> seg, ESolver solver, float tolerance, list< CPairT<T> > * route, unsigned long version )
+/* Remembers 'route', unless the scene has changed since 'version', when the route was planned. */
+{
+	lock_guard<mutex> hold( this->lock );
+	this->Validate();
+	SRouteKeyT<T> key = Key( seg, solver, tolerance );
+	if ( version != this->version or this->keys.count(key) )
+		return;
+	this->entries.push_front( SEntry{ key, *route } );
+	this->keys[key] = this->entries.begin();
+	while ( this->entries.size() > this->capacity )
+	{
+		this->keys.erase( this->entries.back().key );
+		this->entries.pop_back();
+		this->stats.evicted ++;
+	}
+}
+
+template <class T>
+SRouteCacheStats CRouteCacheT<T>::Stats(void)
+{
+	lock_guard<mutex> hold( this->lock );
+	SRouteCacheStats stats = this->stats;
+	stats.size = this->entries.size();
+	return stats;
+}
+
+template <class T>
+void CRouteCacheT<T>::clear(void)
+{
+	lock_guard<mutex> hold( this->lock );
+	this->entries.clear();
+	this->keys.clear();
+}
+
+template <class T>
+list< CPairT<T> > FindRoute( typename SSegArg<T>::type seg, CRouteCacheT<T> * cache, ESolver solver, float tolerance )
+/* As 'FindRoute' on the cache's scene, answered from the cache when it can be. With a grid step,
+ * the route runs between the snapped end points. When several threads query at once,
+ * 'Prepare' the scene for 'solver' first. */
+{
+	list< CPairT<T> > route;
+	seg = cache->Snap(seg);
+	if ( cache->Find( seg, solver, tolerance, &route ) )
+		return route;
+	unsigned long version = cache->Scene()->Version();
+	route = FindRoute( seg, cache->Scene(), solver, tolerance );
+	cache->Store( seg, solver, tolerance, &route, version );
+	return route;
+}
+
+/// Goal maps //////////////////////////////////////////////////////////
+
+template <class T>
+CGoalMapT<T>::CGoalMapT( CSceneT<T> * scene, CPairT<T> goal )
+{
+	this->scene = scene;
+	this->goal = goal;
+	this->scene->Graph()->Tree( goal, &this->cost, &this->toward );
+	this->version = scene->Version();
+}
+
+template <class T>
+CPairT<T> CGoalMapT<T>::Goal(void)
+{
+	return this->goal;
+}
+
+template <class T>
+unsigned int CGoalMapT<T>::Reached(void)
+{
+	return count_if( this->cost.begin(), this->cost.end(), []( double c ) { return c < HUGE_VAL; } );
+}
+
+template <class T>
+list< CPairT<T> > CGoalMapT<T>::FindPath( CPairT<T> start )
+{
+	if ( this->scene->Version() != this->version )
+		return ::FindRoute( SSegT<T>{ start, this->goal }, this->scene, SOLVER_VISIBILITY, 0 );
+	return this->scene->Graph()->FindPath( start, this->goal, &this->cost, &this->toward );
+}
+
+template <class T>
+list< CPairT<T> > FindRoute( CPairT<T> start, CGoalMapT<T> * goals )
+{
+	CStatsScope scope( SSegT<T>{ start, goals->Goal() } );
+	return goals->FindPath(start);
+}
+
+/// Tiled scenes ///////////////////////////////////////////////////////
+
+template <class T>
+CTileStoreT<T> * CTileStoreT<T>::Open( string path, double side )
+{
+	size_t size;
+	const SSceneHeader * map = MapSceneBinary( path, &size );
+	return ( map ? new CTileStoreT( map, size, side ) : 0 );
+}
+
+template <class T>
+CTileStoreT<T>::CTileStoreT( const SSceneHeader * map, size_t map_size, double side )
+/* Reads every vertex once, for the bounds, and then lets the pages go until a tile needs them.
+ * Obstacles with no vertices meet nothing, so they go to no tile. */
+{
+	this->map = map;
+	this->map_size = map_size;
+	this->offsets = (const unsigned int *)( map + 1 );
+	this->xs = (const float *)( this->offsets + map->obstacles + 1 );
+	this->ys = this->xs + map->vertices;
+
+	vector< SBoxT<T> > boxes( map->obstacles );
+	vector<double> cx( map->obstacles ), cy( map->obstacles );	// box centres, in file units
+	double xmin = HUGE_VAL, ymin = HUGE_VAL, xmax = -HUGE_VAL, ymax = -HUGE_VAL;
+	for ( unsigned int n = 0; n < map->obstacles; n ++ )
+	{
+		unsigned int lo = this->offsets[n], hi = this->offsets[n+1];
+		if ( lo == hi )
+			continue;
+		float x_lo = this->xs[lo], y_lo = this->ys[lo], x_hi = x_lo, y_hi = y_lo;
+		for ( unsigned int i = lo + 1; i < hi; i ++ )
+		{
+			x_lo = min( x_lo, this->xs[i] ), y_lo = min( y_lo, this->ys[i] );
+			x_hi = max( x_hi, this->xs[i] ), y_hi = max( y_hi, this->ys[i] );
+		}
+		// 'From' keeps order, so this is 'Bounds' of the obstacle as it will be loaded
+		boxes[n] = BoxPad( SBoxT<T>{ SCoord<T>::From(x_lo), SCoord<T>::From(y_lo), SCoord<T>::From(x_hi), SCoord<T>::From(y_hi) } );
+		cx[n] = ( (double)x_lo + x_hi ) / 2, cy[n] = ( (double)y_lo + y_hi ) / 2;
+		xmin = min( xmin, (double)x_lo ), ymin = min( ymin, (double)y_lo );
+		xmax = max( xmax, (double)x_hi ), ymax = max( ymax, (double)y_hi );
+	}
+	bool empty = ( xmin > xmax );
+	this->side = side;
+	this->x0 = ( empty ? 0 : xmin );
+	this->y0 = ( empty ? 0 : ymin );
+	this->nx = ( empty ? 1 : max( 1, (int)ceil( (xmax - xmin) / side ) ) );
+	this->ny = ( empty ? 1 : max( 1, (int)ceil( (ymax - ymin) / side ) ) );
+
+	// sort the obstacles by tile (a counting sort, so each tile keeps them in file order)
+	int tiles = this->nx * this->ny;
+	vector<int> tile_of( map->obstacles, -1 );
+	this->first.assign( tiles + 1, 0 );
+	for ( unsigned int n = 0; n < map->obstacles; n ++ )
+	{
+		if ( this->offsets[n] == this->offsets[n+1] )
+			continue;
+		int	tx = min( this->nx - 1, max( 0, (int)floor( (cx[n] - this->x0) / side ) ) ),
+			ty = min( this->ny - 1, max( 0, (int)floor( (cy[n] - this->y0) / side ) ) );
+		tile_of[n] = ty * this->nx + tx;
+		this->first[ tile_of[n] + 1 ] ++;
+	}
+	for ( int t = 0; t < tiles; t ++ )
+		this->first[t+1] += this->first[t];
+	vector<unsigned int> next( this->first.begin(), this->first.end() - 1 );
+	this->members.resize( this->first[tiles] );
+	this->bounds.assign( tiles, SBoxT<T>{ 0, 0, 0, 0 } );
+	for ( unsigned int n = 0; n < map->obstacles; n ++ )
+	{
+		if ( tile_of[n] < 0 )
+			continue;
+		int t = tile_of[n];
+		this->bounds[t] = ( next[t] == this->first[t] ? boxes[n] : BoxUnion( this->bounds[t], boxes[n] ) );
+		this->members[ next[t] ++ ] = n;
+	}
+
+	// the hierarchy over the tiles that have obstacles, which in row order stay close together
+	vector< SBoxT<T> > tile_boxes;
+	for ( int t = 0; t < tiles; t ++ )
+	{
+		if ( this->first[t+1] > this->first[t] )
+			this->order.push_back(t), tile_boxes.push_back( this->bounds[t] );
+	}
+	if ( !tile_boxes.empty() )
+		BuildBVH( &this->nodes, &tile_boxes, 0, tile_boxes.size() );
+	// from now on the file is read a tile at a time, so read no more of it than that
+	madvise( (void *)this->map, this->map_size, MADV_DONTNEED );
+	madvise( (void *)this->map, this->map_size, MADV_RANDOM );
+}
+
+template <class T>
+CTileStoreT<T>::~CTileStoreT()
+{
+	munmap( (void *)this->map, this->map_size );
+}
+
+template <class T>
+unsigned int CTileStoreT<T>::size(void)
+{
+	return this->nx * this->ny;
+}
+
+template <class T>
+unsigned int CTileStoreT<T>::Obstacles( int tile )
+{
+	return this->first[tile+1] - this->first[tile];
+}
+
+template <class T>
+int CTileStoreT<T>::Tiles( SSegT<T> seg, vector<int> * tiles )
+{
+	vector<int> items;
+	tiles->clear();
+	QueryBVH( &this->nodes, seg, &items );
+	for ( int item : items )
+	{
+		if ( BoxHitsSeg( this->bounds[ this->order[item] ], seg ) )
+			tiles->push_back( this->order[item] );
+	}
+	return tiles->size();
+}
+
+template <class T>
+void CTileStoreT<T>::Load( int tile, list< CObstacleT<T> > * obstacles, vector<int> * numbers )
+/* Closes each polygon, as 'LoadSceneBinary' does, so that both give the same obstacles.
+ * The obstacles hold copies of their vertices, so the pages they came from go straight back. */
+{
+	vector<T> x, y;
+	for ( unsigned int m = this->first[tile]; m < this->first[tile+1]; m ++ )
+	{
+		unsigned int n = this->members[m], lo = this->offsets[n], hi = this->offsets[n+1];
+		x.clear(), y.clear();
+		for ( unsigned int i = lo; i < hi; i ++ )
+			x.push_back( SCoord<T>::From( this->xs[i] ) ), y.push_back( SCoord<T>::From( this->ys[i] ) );
+		obstacles->push_back( CObstacleT<T>( x.data(), y.data(), hi - lo, true ) );
+		numbers->push_back(n);
+	}
+	this->Release(tile);
+}
+
+template <class T>
+void CTileStoreT<T>::Release( int tile )
+/* The kernel maps pages around the one a read faults in, as far as TILES_FAULT_AROUND, so as much
+ * is dropped around each run. The mapping is read-only, so dropping a page that other vertices
+ * are read from only costs reading it again. A tile's obstacles are in file order, so the windows
+ * of one run after another are merged into as few calls as they allow. */
+{
+	for ( const float * run : { this->xs, this->ys } )
+	{
+		uintptr_t	start = (uintptr_t)this->map, end = start + this->map_size,
+					lo = 0, hi = 0;
+		for ( unsigned int m = this->first[tile]; m <= this->first[tile+1]; m ++ )
+		{
+			uintptr_t next_lo = end, next_hi = end;
+			if ( m < this->first[tile+1] )
+			{
+				unsigned int n = this->members[m];
+				next_lo = max( (uintptr_t)( run + this->offsets[n] ) & ~(uintptr_t)( TILES_FAULT_AROUND - 1 ), start );
+				next_hi = min( (uintptr_t)( run + this->offsets[n+1] ) + TILES_FAULT_AROUND, end );
+			}
+			if ( next_lo > hi or m == this->first[tile+1] )
+			{
+				if ( hi > lo )
+					madvise( (void *)lo, hi - lo, MADV_DONTNEED );
+				lo = next_lo;
+			}
+			hi = max( hi, next_hi );
+		}
+	}
+}
+
+template <class T>
+CTiledSceneT<T>::CTiledSceneT( CTileStoreT<T> * store, unsigned int max_resident )
+{
+	list< CObstacleT<T> > none;
+	this->store = store;
+	this->tiles.resize( store->size() );
+	for ( STile & tile : this->tiles )
+		tile.resident = false, tile.used = 0;
+	this->max_resident = max_resident;
+	this->queries = 0;
+	this->index = new CObstacleIndexT<T>(&none);
+	this->index->SetPager(this);
+}
+
+template <class T>
+CTiledSceneT<T>::~CTiledSceneT()
+{
+	delete this->index;
+}
+
+template <class T>
+CObstacleIndexT<T> * CTiledSceneT<T>::Index(void)
+{
+	return this->index;
+}
+
+template <class T>
+unsigned int CTiledSceneT<T>::Resident(void)
+{
+	return this->resident.size();
+}
+
+template <class T>
+void CTiledSceneT<T>::Page( SSegT<T> seg )
+/* The new obstacles take their numbers in the file, which no resident obstacle holds,
+ * and 'FindPath' goes on with the numbers it holds: routes found before a tile came in stay valid,
+ * as no segment they were found for meets it. */
+{
+	this->store->Tiles( seg, &this->hits );
+	for ( int t : this->hits )
+	{
+		STile & tile = this->tiles[t];
+		tile.used = this->queries;
+		if ( tile.resident )
+			continue;
+		this->store->Load( t, &tile.obstacles, &tile.numbers );
+		typename list< CObstacleT<T> >::iterator it = tile.obstacles.begin();
+		for ( int n : tile.numbers )
+			this->index->Insert( n, &*it ++ );
+		tile.resident = true;
+		this->resident.push_back(t);
+		if ( query_stats )
+			query_stats->tiles_loaded ++;
+	}
+}
+
+template <class T>
+void CTiledSceneT<T>::Drop( int tile )
+{
+	for ( int n : this->tiles[tile].numbers )
+		this->index->Remove(n);
+	this->tiles[tile].obstacles.clear();
+	this->tiles[tile].numbers.clear();
+	this->tiles[tile].resident = false;
+}
+
+template <class T>
+void CTiledSceneT<T>::Trim(void)
+{
+	this->queries ++;
+	while ( this->resident.size() > this->max_resident )
+	{
+		vector<int>::iterator oldest = min_element( this->resident.begin(), this->resident.end(),
+			[this]( int a, int b ) { return this->tiles[a].used < this->tiles[b].used; } );
+		this->Drop(*oldest);
+		this->resident.erase(oldest);
+	}
+}
+
+template <class T>
+list< CPairT<T> > FindRoute( typename SSegArg<T>::type seg, CTiledSceneT<T> * scene, float tolerance )
+/* 'FindPath' and then 'OptimizePath' (with 'tolerance'), on the tiles of 'scene' the route needs. */
+{
+	CStatsScope scope(seg);
+	double started = ( query_stats ? StatsMicros() : 0 ), now;
+	CPathMemoT<T> memo;
+	CArena arena;
+	scene->Trim();
+	CArenaPathT<T> route = FindPath( seg, scene->Index(), 0, 0, &memo, &arena );
+	if ( query_stats )
+		now = StatsMicros(), query_stats->findpath_us += now - started, started = now;
+	OptimizePath( &route, scene->Index(), tolerance, &memo, 0, &arena );
+	if ( query_stats )
+	{
+		query_stats->optimize_us += StatsMicros() - started;
+		query_stats->arena_bytes += arena.Capacity();
+	}
+	return list< CPairT<T> >( route.begin(), route.end() );
+}
+
+/// Shared scenes //////////////////////////////////////////////////////
+
+template <class T>
+CSharedSceneT<T>::CSharedSceneT( list< CObstacleT<T> > * obstacles, ESolver solver )
+{
+	this->solver = solver;
+	this->staged.assign( obstacles->begin(), obstacles->end() );
+	this->live.assign( this->staged.size(), 1 );
+	for ( SSlot & slot : this->slots )
+		slot.epoch = ~0UL, slot.taken = false;
+	CSceneT<T> * scene = new CSceneT<T>(obstacles);
+	scene->Prepare(solver);
+	this->current = scene;
+	this->epoch = 0;
+	this->version = 0;
+}
+
+template <class T>
+CSharedSceneT<T>::~CSharedSceneT()
+{
+	for ( SRetired & old : this->retired )
+		delete old.scene;
+	delete this->current.load();
+}
+
+template <class T>
+ESolver CSharedSceneT<T>::Solver(void)
+{
+	return this->solver;
+}
+
+template <class T>
+int CSharedSceneT<T>::Join(void)
+{
+	for ( int reader = 0; reader < SCENE_READERS_MAX; reader ++ )
+	{
+		bool taken = false;
+		if ( this->slots[reader].taken.compare_exchange_strong( taken, true ) )
+			return reader;
+	}
+	return -1;
+}
+
+template <class T>
+void CSharedSceneT<T>::Leave( int reader )
+{
+	this->slots[reader].epoch = ~0UL;
+	this->slots[reader].taken = false;
+}
+
+template <class T>
+CSceneT<T> * CSharedSceneT<T>::Pin( int reader )
+/* The epoch goes into the slot before the snapshot is loaded (both sequentially consistent), so a writer
+ * that swaps the snapshot out afterwards either sees this reader pinned at or before the retirement,
+ * or the reader loads the new snapshot. */
+{
+	this->slots[reader].epoch = this->epoch.load();
+	return this->current.load();
+}
+
+template <class T>
+void CSharedSceneT<T>::Unpin( int reader )
+{
+	this->slots[reader].epoch = ~0UL;
+}
+
+template <class T>
+int CSharedSceneT<T>::Insert( CObstacleT<T> * obstacle )
+{
+	lock_guard<mutex> hold( this->lock );
+	this->staged.push_back(*obstacle);
+	this->live.push_back(1);
+	return this->staged.size() - 1;
+}
+
+template <class T>
+bool CSharedSceneT<T>::Update( int number, CObstacleT<T> * obstacle )
+{
+	lock_guard<mutex> hold( this->lock );
+	if ( number < 0 or number >= (int)this->staged.size() or !this->live[number] )
+		return false;
+	this->staged[number] = *obstacle;
+	return true;
+}
+
+template <class T>
+bool CSharedSceneT<T>::Remove( int number )
+/* The number is not reused. */
+{
+	lock_guard<mutex> hold( this->lock );
+	if ( number < 0 or number >= (int)this->staged.size() or !this->live[number] )
+		return false;
+	this->staged[number] = CObstacleT<T>();
+	this->live[number] = 0;
+	return true;
+}
+
+template <class T>
+unsigned long CSharedSceneT<T>::Publish(void)
+/* The new snapshot is built and prepared while readers carry on with the old one;
+ * only the swap itself is seen by them. */
+{
+	lock_guard<mutex> hold( this->lock );
+	list< CObstacleT<T> > obstacles;
+	for ( unsigned int n = 0; n < this->staged.size(); n ++ )
+	{
+		if ( this->live[n] )
+			obstacles.push_back( this->staged[n] );
+	}
+	CSceneT<T> * scene = new CSceneT<T>( &obstacles );
+	scene->Prepare( this->solver );
+	CSceneT<T> * old = this->current.exchange(scene);
+	this->retired.push_back( SRetired{ old, this->epoch.fetch_add(1) } );
+	this->version ++;
+	this->Reclaim();
+	return this->version;
+}
+
+template <class T>
+void CSharedSceneT<T>::Reclaim(void)
+/* A snapshot retired at epoch 'e' can only be held by readers that pinned at 'e' or before. */
+{
+	unsigned long oldest = ~0UL;
+	for ( SSlot & slot : this->slots )
+		oldest = min( oldest, slot.epoch.load() );
+	unsigned int kept = 0;
+	for ( SRetired & old : this->retired )
+	{
+		if ( old.epoch < oldest )
+			delete old.scene;
+		else
+			this->retired[kept ++] = old;
+	}
+	this->retired.resize(kept);
+}
+
+template <class T>
+unsigned long CSharedSceneT<T>::Version(void)
+{
+	lock_guard<mutex> hold( this->lock );
+	return this->version;
+}
+
+template <class T>
+unsigned int CSharedSceneT<T>::Retired(void)
+{
+	lock_guard<mutex> hold( this->lock );
+	return this->retired.size();
+}
+
+template <class T>
+list< CPairT<T> > FindRoute( typename SSegArg<T>::type seg, CSharedSceneT<T> * scene, int reader, float tolerance )
+/* As 'FindRoute' with the scene's engine, on the snapshot current when the query starts. */
+{
+	CSceneT<T> * snapshot = scene->Pin(reader);
+	list< CPairT<T> > route = FindRoute( seg, snapshot, scene->Solver(), tolerance );
+	scene->Unpin(reader);
+	return route;
+}
+
+/// Coordinate types ///////////////////////////////////////////////////
+
+#define INSTANTIATE_COORDS(T)																				\
+	template class CPairT<T>;																				\
+	template class CObstacleT<T>;																			\
+	template list< CObstacleT<T> > Simplify<T>( list< CObstacleT<T> > * obstacles, double tolerance );		\
+	template class CObstacleIndexT<T>;																		\
+	template class CPathMemoT<T>;																			\
+	template class CVisibilityGraphT<T>;																	\
+	template unsigned long long SceneHash<T>( CObstacleIndexT<T> * index );									\
+	template class CSceneT<T>;																				\
+	template class CRegionMapT<T>;																			\
+	template class CGridMapT<T>;																			\
+	template class CRouteCacheT<T>;																			\
+	template class CGoalMapT<T>;																			\
+	template class CTileStoreT<T>;																			\
+	template class CTiledSceneT<T>;																			\
+	template class CSharedSceneT<T>;																			\
+	template CStatsScope::CStatsScope( SSegT<T> seg );														\
+	template void PrintPath<T>( list< CPairT<T> > * path );													\
+	template void PrintPath<T>( CArenaPathT<T> * path );													\
+	template void PrintWXMaxGraph<T>( list< CPairT<T> > * path, string blurb );								\
+	template list< CPairT<T> > ConcatPaths<T>( list< CPairT<T> > * path1, list< CPairT<T> > * path2 );		\
+	template list< CPairT<T> > ConcatPaths<T>( list< list< CPairT<T> > * > paths );							\
+	template void PrintSeg<T>( SSegT<T> seg );																\
+	template SBoxT<T> BoxOf<T>( CPairT<T> pt );																\
+	template SBoxT<T> BoxUnion<T>( SBoxT<T> a, SBoxT<T> b );												\
+	template SBoxT<T> BoxPad<T>( SBoxT<T> box );															\
+	template bool BoxesOverlap<T>( SBoxT<T> a, SBoxT<T> b );												\
+	template bool BoxHitsSeg<T>( SBoxT<T> box, SSegT<T> seg );												\
+	template int BuildBVH<T>( vector< SBVHNodeT<T> > * nodes, vector< SBoxT<T> > * boxes, int lo, int hi );	\
+	template int QueryBVH< T, vector<int> >( vector< SBVHNodeT<T> > * nodes, SSegT<T> seg, vector<int> * hits );	\
+	template int QueryBVH<T, CArenaInts>( vector< SBVHNodeT<T> > * nodes, SSegT<T> seg, CArenaInts * hits );	\
+	template int CObstacleT<T>::EdgeCandidates< vector<int> >( SSegT<T> seg, vector<int> * edges );			\
+	template int CObstacleT<T>::EdgeCandidates<CArenaInts>( SSegT<T> seg, CArenaInts * edges );				\
+	template int CObstacleIndexT<T>::Candidates< vector<int> >( SSegT<T> seg, vector<int> * hits );			\
+	template int CObstacleIndexT<T>::Candidates<CArenaInts>( SSegT<T> seg, CArenaInts * hits );				\
+	template bool Solve2by2System<T>( T A, T B, T a, T b, T c, T d, CPairT<T> * soln );						\
+	template double Orient<T>( CPairT<T> a, CPairT<T> b, CPairT<T> c );										\
+	template int OrientSign<T>( CPairT<T> a, CPairT<T> b, CPairT<T> c );									\
+	template bool SegIntersectExact<T>( SSegT<T> seg1, SSegT<T> seg2, SCoord<T>::real * kappa, CPairT<T> * isect );	\
+	template bool SegIntersect<T>( CPairT<T> seg1start, CPairT<T> seg1end, CPairT<T> seg2start, CPairT<T> seg2end,	\
+								   SCoord<T>::real * kappa, CPairT<T> * isect );							\
+	template bool SegIntersect<T>( SSegT<T> seg1, SSegT<T> seg2, SCoord<T>::real * kappa, CPairT<T> * isect );	\
+	template unsigned int SegIntersectBlock<T>( SSegT<T> seg, const T * x, const T * y, int n,				\
+												SCoord<T>::real * kappa, T * ix, T * iy );					\
+	template bool compare_k<T>( const SIsectDataT<T> & first, const SIsectDataT<T> & second );				\
+	template int ObstacleIntersection<T>( SSegT<T> seg, CObstacleT<T> * obstacle, list< SIsectDataT<T> > * isects, float tolerance );	\
+	template int ObstacleIntersection<T>( SSegT<T> seg, CObstacleT<T> * obstacle, CArenaIsectsT<T> * isects, float tolerance );	\
+	template int Circumvent<T>( int entry, int exit, CObstacleT<T> * obstacle, bool clockwise, CArenaPathT<T> * route );	\
+	template list< CPairT<T> > Circumvent<T>( SSegT<T> seg, CObstacleT<T> * obstacle, bool clockwise );		\
+	template SCoord<T>::real SegLen<T>( CPairT<T> start, CPairT<T> end );									\
+	template SCoord<T>::real PathLen<T>( list< CPairT<T> > * ptlist );										\
+	template SCoord<T>::real PathLen<T>( CArenaPathT<T> * ptlist );											\
+	template list< CPairT<T> > minCircumvent<T>( SSegT<T> seg, CObstacleT<T> * obstacle );					\
+	template CArenaPathT<T> FindPath<T>( SSegT<T> seg, CObstacleIndexT<T> * index, int first, float tolerance, CPathMemoT<T> * memo, CArena * arena );	\
+	template list< CPairT<T> > FindPath<T>( SSegT<T> seg, CObstacleIndexT<T> * index, int first, float tolerance, CPathMemoT<T> * memo );	\
+	template list< CPairT<T> > FindPath<T>( SSegT<T> seg, CObstacleIndexT<T> * index, float tolerance, CPathMemoT<T> * memo );	\
+	template list< CPairT<T> > FindPath<T>( SSegT<T> seg, list< CObstacleT<T> > * obstacles, float tolerance );	\
+	template list< CPairT<T> > FindPath<T>( SSegT<T> seg, list< CObstacleT<T> > * obstacles );				\
+	template bool CornerCuttable<T>( CPairT<T> anchor, CPairT<T> candidate, CPairT<T> pt );					\
+	template bool OptimizePath<T>( CArenaPathT<T> * sequence, CObstacleIndexT<T> * index, float tolerance, CPathMemoT<T> * memo, CThreadPool * pool,	\
+								   CArena * arena, SBudget * budget );											\
+	template bool OptimizePath<T>( CArenaPathT<T> * sequence, CObstacleIndexT<T> * index, float tolerance, CPathMemoT<T> * memo, CThreadPool * pool, CArena * arena );	\
+	template bool OptimizePath<T>( list< CPairT<T> > * sequence, CObstacleIndexT<T> * index, float tolerance, CPathMemoT<T> * memo, CThreadPool * pool );	\
+	template bool OptimizePath<T>( list< CPairT<T> > * sequence, CObstacleIndexT<T> * index, float tolerance, CPathMemoT<T> * memo );	\
+	template bool OptimizePath<T>( list< CPairT<T> > * sequence, list< CObstacleT<T> > * obstacles, float tolerance );	\
+	template list< CPairT<T> > FindRoute<T>( SSegT<T> seg, CSceneT<T> * scene, ESolver solver, float tolerance, CPathMemoT<T> * memo, CArena * arena );	\
+	template list< CPairT<T> > FindRoute<T>( SSegT<T> seg, CSceneT<T> * scene, ESolver solver, float tolerance, CPathMemoT<T> * memo );	\
+	template list< CPairT<T> > FindRoute<T>( SSegT<T> seg, CSceneT<T> * scene, ESolver solver, float tolerance );	\
+	template list< CPairT<T> > FindRoute<T>( SSegT<T> seg, CSceneT<T> * scene, float tolerance, SBudget * budget, bool * optimized );	\
+	template list< CPairT<T> > FindRoute<T>( SSegT<T> seg, CRegionMapT<T> * regions );						\
+	template list< CPairT<T> > FindRoute<T>( SSegT<T> seg, CGridMapT<T> * grid );							\
+	template list< CPairT<T> > FindRoute<T>( SSegT<T> seg, CRouteCacheT<T> * cache, ESolver solver, float tolerance );	\
+	template list< CPairT<T> > FindRoute<T>( CPairT<T> start, CGoalMapT<T> * goals );						\
+	template list< CPairT<T> > FindRoute<T>( SSegT<T> seg, CTiledSceneT<T> * scene, float tolerance );		\
+	template list< CPairT<T> > FindRoute<T>( SSegT<T> seg, CSharedSceneT<T> * scene, int reader, float tolerance );	\
+	template vector< list< CPairT<T> > > FindRoutes<T>( vector< SSegT<T> > * queries, CSceneT<T> * scene, ESolver solver, float tolerance, CThreadPool * pool );	\
+	template vector< list< CPairT<T> > > FindRoutes<T>( vector< SSegT<T> > * queries, CSceneT<T> * scene, ESolver solver, float tolerance );
+
+INSTANTIATE_COORDS(float)
+INSTANTIATE_COORDS(double)
+INSTANTIATE_COORDS(int)
@@ -0,0 +1,1185 @@
+/*
+ * PathFinder.h
+ * 
+ * Copyright 2015 Joseph Lindgren <joseph.lindgren@uky.edu>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+
+/* 
+ * Declarations shared by the path finding code in PathFinder.cxx,
+ * the demo (main.cxx) and the benchmarks (Benchmark.cxx).
+ */
+
+#ifndef PATHFINDER_H
+#define PATHFINDER_H
+
+#include <iostream>
+#include <string>
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <deque>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cmath>
+
+#define RIGHT	true
+#define LEFT	false
+#define DEBUGGING  false
+#define BVH_LEAF_SIZE	8	// max number of edges (or obstacles) in a leaf of a bounding volume hierarchy
+#define EDGE_BLOCK		32	// max number of edges 'SegIntersectBlock' tests in one call
+#define HULL_AXES		8	// max number of hull edges an obstacle keeps as separating axes
+#define HULL_TEST_MAX	32	// larger hulls are not tested against a segment; the edge hierarchy does as well
+#define INDEX_LOOSE_MAX	32	// obstacles added or changed since an index was built before it gets rebuilt
+#define FIXED_SHIFT		8	// fraction bits of fixed-point (int) coordinates: they count 1/256ths
+
+using namespace std;
+
+/// Coordinates ////////////////////////////////////////////////////////
+
+/* Everything that holds or works on coordinates is a template on their type T, instantiated
+ * (at the end of PathFinder.cxx) for float, double and int, the last being fixed point:
+ * an int coordinate counts 1/2^FIXED_SHIFT units, and must stay strictly between -2^30 and 2^30
+ * so that the orientation tests are exact in 64 bits (at 2^30 itself a determinant can reach 2^63).
+ * The float instantiation goes by the plain names ('CPair', 'CObstacle', ...),
+ * the others by the template names ('CPairT<double>', ...).
+ * Each instantiation gets its own intersection kernels: SIMD with a rounding filter for float,
+ * the same filter in scalar code for double, and exact integer arithmetic for int. */
+
+template <class T> struct SCoord;
+
+template <> struct SCoord<float>
+{
+	typedef float real;		// for kappas and lengths
+	static double Value( float v ) { return v; } // the number a coordinate stands for
+	static float From( double value ) { return value; } // the coordinate nearest 'value'
+	static float Near( double v ) { return v; } // the coordinate nearest 'v', in the units of the coordinates
+	static float Up( double v ) { return v; } // one no less than 'v' (give or take rounding), in the same units
+	static double Slack(void) { return 1e-5; } // relative margin for rounding that the culling tests allow
+	static float Doubt(void) { return 9.5367431640625e-7f; } // 2^-20: see 'SegInDoubt'
+};
+
+template <> struct SCoord<double>
+{
+	typedef double real;
+	static double Value( double v ) { return v; }
+	static double From( double value ) { return value; }
+	static double Near( double v ) { return v; }
+	static double Up( double v ) { return v; }
+	static double Slack(void) { return 1e-12; }
+	static double Doubt(void) { return 1.7763568394002505e-15; } // 2^-49
+};
+
+template <> struct SCoord<int>
+{
+	typedef double real;
+	static double Value( int v ) { return v / (double)(1 << FIXED_SHIFT); }
+	static int From( double value ) { return lround( value * (1 << FIXED_SHIFT) ); }
+	static int Near( double v ) { return lround(v); }
+	static int Up( double v ) { return ceil(v); }
+	static double Slack(void) { return 1e-12; }
+	static int Doubt(void) { return 0; } // never in doubt: every test is exact
+};
+
+template <class T>
+class CPairT
+{
+	private:
+		T x,y;
+		bool on_obstacle, clockwise;
+		bool side;
+
+	public:
+		typedef typename SCoord<T>::real real;
+
+		CPairT();
+		CPairT(T x, T y);
+		CPairT(T x, T y, bool on_obstacle, bool clockwise);
+		
+		void SetClockwise(bool cw);
+		bool GetClockwise(void);
+		void SetOnObstacle(bool on_obs);
+		bool GetOnObstacle(void);
+		void SetSide(bool side);
+		bool GetSide(void);
+		
+		CPairT & operator=( const CPairT & other );
+		bool operator==( const CPairT & other );
+		CPairT & operator+=( const CPairT & other );
+		CPairT & operator-=( const CPairT & other );
+		const CPairT operator+( const CPairT & rhs );
+		const CPairT operator-( const CPairT & rhs );
+		real operator*( const CPairT & rhs );
+		const CPairT operator*( real scalar );
+
+		string SPrint(void);
+		T GetX(void);
+		T GetY(void);
+		
+		real Angle( CPairT other );
+		CPairT Normal(void);
+};
+
+typedef CPairT<float> CPair;
+
+template <class T> void PrintPath( list< CPairT<T> > * path );
+template <class T> void PrintWXMaxGraph( list< CPairT<T> > * path, string blurb );
+template <class T> list< CPairT<T> > ConcatPaths( list< CPairT<T> > * path1, list< CPairT<T> > * path2 );
+template <class T> list< CPairT<T> > ConcatPaths( list< list< CPairT<T> > * > paths );
+
+template <class T>
+struct SSegT
+{
+	CPairT<T> start, end;
+};
+
+typedef SSegT<float> SSeg;
+
+template <class T> struct SSegArg { typedef SSegT<T> type; }; // a segment parameter that braced lists convert to, 'T' coming from the others
+
+template <class T> void PrintSeg( SSegT<T> seg );
+
+/// Bounding volumes ///////////////////////////////////////////////////
+
+template <class T>
+struct SBoxT
+{
+	T xmin, ymin, xmax, ymax;
+};
+
+typedef SBoxT<float> SBox;
+
+template <class T> SBoxT<T> BoxOf( CPairT<T> pt );
+template <class T> SBoxT<T> BoxUnion( SBoxT<T> a, SBoxT<T> b );
+template <class T> SBoxT<T> BoxPad( SBoxT<T> box );
+template <class T> bool BoxesOverlap( SBoxT<T> a, SBoxT<T> b );
+template <class T> bool BoxHitsSeg( SBoxT<T> box, SSegT<T> seg );
+
+template <class T>
+struct SBVHNodeT
+/* A node of a bounding volume hierarchy stored depth-first in a vector:
+ * the left child of an inner node directly follows it, and 'first' holds the index of the right child.
+ * A leaf covers the items 'first' ... 'first + count - 1'. */
+{
+	SBoxT<T> box;
+	int first, count;
+};
+
+template <class T> int BuildBVH( vector< SBVHNodeT<T> > * nodes, vector< SBoxT<T> > * boxes, int lo, int hi );
+template <class T, class TInts> int QueryBVH( vector< SBVHNodeT<T> > * nodes, SSegT<T> seg, TInts * hits ); // 'TInts' a vector of int (heap or arena)
+
+struct SStrip
+/* A node of a strip tree over a chain of edges, stored depth-first like 'SBVHNodeT'.
+ * It stands for a run of edges by the one segment 'a'-'b' from the run's first vertex to its last,
+ * and 'width' is how far any vertex of the run strays from that segment: the run lies inside the capsule
+ * of that radius around it. The children halve the run, so the nodes at each depth make a coarser
+ * outline of the chain, always grown to cover it, and the leaves are the edges themselves. */
+{
+	double ax, ay, bx, by, width;
+	double xmin, ymin, xmax, ymax;	// the box around the run, checked first
+	int first, count;	// the edges 'first' ... 'first + count - 1'
+	int right;			// the index of the right child (the left one directly follows), or 0 for a leaf
+	bool thin;			// whether the capsule is worth testing after the box (it is much smaller)
+};
+
+bool StripNearSeg( SStrip * strip, double ax, double ay, double bx, double by, double reach ); // whether the segment 'a'-'b' comes within 'reach' of the strip's box and capsule
+
+/// Obstacles //////////////////////////////////////////////////////////
+
+template <class T>
+struct SPtsViewT
+/* A non-owning view of a run of obstacle vertices, stored as separate x and y arrays.
+ * It stays valid until the obstacle it was taken from is changed or destroyed. */
+{
+	const T * x, * y;
+	unsigned int n;
+};
+
+typedef SPtsViewT<float> SPtsView;
+
+struct SAxis
+/* A separating axis of an obstacle: the outward unit normal of an edge of its convex hull,
+ * and how far the (slightly grown) obstacle reaches along it. */
+{
+	double nx, ny, extent;
+};
+
+#define PT_ON_OBSTACLE	1	// flag bits kept for each obstacle vertex
+#define PT_CLOCKWISE	2
+#define PT_SIDE			4
+
+template <class T>
+class CObstacleT
+{
+	private:
+		typedef CPairT<T> CPair;
+		typedef SSegT<T> SSeg;
+		typedef SBoxT<T> SBox;
+		typedef SPtsViewT<T> SPtsView;
+
+		vector<T> xs, ys;				// vertex coordinates, struct-of-arrays so edge loops stream through memory
+		vector<unsigned char> flags;	// PT_ON_OBSTACLE | PT_CLOCKWISE | PT_SIDE of each vertex
+		vector<SStrip> strips;	// levels of detail over the edges, rebuilt on demand after the points change
+		SBox bounds;			// of the whole obstacle, rebuilt along with 'strips' (as are the hull and axes)
+		vector<T> hull;			// the convex hull, counterclockwise: all the x, then all the y
+		SAxis axes[HULL_AXES];	// a few of the hull's edges, for quick rejection
+		int num_axes;
+		double pad;				// the margin the hull tests allow for rounding
+		bool bvh_dirty;
+
+		void BuildHull(void);
+		int BuildStrips( int first, int last ); // over the edges from vertex 'first' to vertex 'last'
+
+	public:
+		CObstacleT();
+		CObstacleT( list<CPair> * pts );
+		CObstacleT( const T * x, const T * y, unsigned int n, bool close ); // bulk copy; 'close' repeats the first point at the end if need be
+		CObstacleT & operator=( const CObstacleT & rhs );
+		CObstacleT & operator+( const CObstacleT & rhs );
+
+		void push_back( CPair pt );
+		unsigned int size( void );
+		list<CPair> GetPts(void);
+		SPtsView Pts(void); // all vertices, without copying them
+		CPair Pt( int i ); // the vertex at zero-based offset 'i'
+		void Print(void);
+		
+		int Index(CPair pt); // returns the offset of the first match to 'pt' (or -1 if there is none)
+		int Vertex( int i ); // the offset of vertex 'i' as 'Circumvent' counts it (the closing point of a closed obstacle is its first)
+		int Split( CPair split_pt, list<CPair> * part1, list<CPair> * part2 ); // splits a list at 'split_pt' and sets each parts to include 'split_pt'. Returns the zero-based index of 'split_pt'
+		int Split( int split, SPtsView * part1, SPtsView * part2 ); // same, at the offset 'split', as views of the obstacle
+		CObstacleT Subset( int start, int end );
+		bool Segment( int segpos, SSeg * segment ); // sets the edge from vertex 'segpos' to the next one
+		void Reverse(void);
+
+		void BuildIndex(void); // (re)builds the strip tree and the hull if the points have changed
+		SBox Bounds(void);
+		SPtsView Hull(void);
+		bool Misses( SSeg seg ); // true only if 'seg' certainly touches none of the edges (box, axes and hull tests)
+		template <class TInts> int EdgeCandidates( SSeg seg, TInts * edges ); // zero-based indices of the edges 'seg' may cross, in order
+		CObstacleT Simplified( double tolerance ); // a coarser outline covering this one, about 'tolerance' (as 'Value' reads it) outside it
+};
+
+typedef CObstacleT<float> CObstacle;
+
+template <class T> list< CObstacleT<T> > Simplify( list< CObstacleT<T> > * obstacles, double tolerance ); // 'Simplified' copies of all of them
+
+/// Intersections //////////////////////////////////////////////////////
+
+template <class T> bool Solve2by2System( T A, T B, T a, T b, T c, T d, CPairT<T> * soln );
+template <class T> double Orient( CPairT<T> a, CPairT<T> b, CPairT<T> c );
+template <class T> int OrientSign( CPairT<T> a, CPairT<T> b, CPairT<T> c ); // the exact sign of 'Orient': 1 if 'c' lies left of the line from 'a' to 'b', -1 if right, 0 if on it
+template <class T> bool SegIntersectExact( typename SSegArg<T>::type seg1, typename SSegArg<T>::type seg2, typename SCoord<T>::real * kappa, CPairT<T> * isect ); // 'SegIntersect' decided exactly, for when rounding leaves it in doubt
+template <class T> bool SegIntersect( CPairT<T> seg1start, CPairT<T> seg1end, CPairT<T> seg2start, CPairT<T> seg2end, typename SCoord<T>::real * kappa, CPairT<T> * isect );
+template <class T> bool SegIntersect( SSegT<T> seg1, SSegT<T> seg2, typename SCoord<T>::real * kappa, CPairT<T> * isect );
+template <class T> unsigned int SegIntersectBlock( SSegT<T> seg, const T * x, const T * y, int n, typename SCoord<T>::real * kappa, T * ix, T * iy );
+
+template <class T>
+struct SIsectDataT
+{
+	typename SCoord<T>::real k;
+	CPairT<T> pair;
+	SSegT<T>  o_seg;
+	int   edge;	// offset of 'o_seg.start' on the obstacle
+};
+
+typedef SIsectDataT<float> SIsectData;
+
+template <class T> bool compare_k( const SIsectDataT<T> & first, const SIsectDataT<T> & second );
+template <class T> int ObstacleIntersection( SSegT<T> seg, CObstacleT<T> * obstacle, list< SIsectDataT<T> > * isects, float tolerance );
+
+template <class T> class CTiledSceneT;
+
+template <class T>
+class CObstacleIndexT
+/* A prebuilt two-level acceleration structure over a set of obstacles:
+ * a bounding volume hierarchy over the obstacle boxes, on top of each obstacle's own hierarchy over its edges.
+ * The obstacles are referenced, not copied, so they must outlive the index and not change under it
+ * unless it is told ('Insert', 'Update', 'Remove'). Those obstacles are checked one by one
+ * until there are more than INDEX_LOOSE_MAX of them, when the hierarchy is rebuilt. */
+{
+	private:
+		typedef CObstacleT<T> CObstacle;
+		typedef SSegT<T> SSeg;
+
+		vector<CObstacle *> obstacles;	// by number; null once removed
+		vector<char> in_tree;	// whether the hierarchy holds each obstacle as it is now
+		vector<int> loose;		// the numbers of the live obstacles it does not
+		vector<int> order;		// obstacle numbers, permuted so that each leaf covers a contiguous run
+		vector< SBVHNodeT<T> > nodes;
+		CTiledSceneT<T> * pager;	// of the tiled scene the index belongs to, if any: it loads what a segment needs
+
+		int Build( vector< SBoxT<T> > * boxes, int lo, int hi );
+		void Rebuild(void);
+
+	public:
+		CObstacleIndexT( list<CObstacle> * obstacles );
+
+		unsigned int size(void); // one more than the highest obstacle number
+		CObstacle * Obstacle( int n ); // null if obstacle 'n' has been removed
+		int Insert( CObstacle * obstacle ); // returns its number
+		void Insert( int n, CObstacle * obstacle ); // as number 'n', which must not be live
+		void Update( int n ); // obstacle 'n' has changed
+		void Remove( int n );
+		template <class TInts> int Candidates( SSeg seg, TInts * hits ); // sets the (sorted) numbers of the obstacles 'seg' may cross
+		bool Blocked( SSeg seg, float tolerance ); // whether any obstacle gets in the way of 'seg' (cf. 'FindPath')
+		void SetPager( CTiledSceneT<T> * pager ); // 'Candidates' first has 'pager' load the tiles 'seg' passes through
+};
+
+typedef CObstacleIndexT<float> CObstacleIndex;
+
+/// Instrumentation ////////////////////////////////////////////////////
+
+#define STATS_QUERIES_MAX	100000	// per-query records a log keeps (it goes on adding up the totals)
+
+struct SQueryStats
+/* What one query (or, added up, many) cost. */
+{
+	float start[2], end[2];			// the query
+	unsigned long seg_tests;		// segment-vs-edge intersection tests
+	unsigned long findpath_calls;	// 'FindPath' levels entered, memo hits included
+	unsigned long memo_hits;
+	unsigned long obstacles_tested;	// obstacles a level tried before finding one in the way (fan-out)
+	unsigned long branches;			// levels that went around an obstacle, each splitting in two
+	unsigned int depth, max_depth;	// of the 'FindPath' recursion
+	unsigned long shortcut_tries, shortcut_takes;	// by 'OptimizePath'
+	unsigned long arena_chunks;		// mallocs made by arenas
+	unsigned long arena_bytes;		// held by the query's arenas when they were done
+	unsigned long tiles_loaded;		// by a tiled scene, for the query
+	double findpath_us, optimize_us, visibility_us, total_us;	// wall time per phase
+
+	void Add( SQueryStats * other );
+	string JSON( bool query );
+};
+
+extern thread_local SQueryStats * query_stats; // where the running query on this thread counts, or null when not counting
+
+class CStatsLog
+/* Collects the stats of the queries run while it is enabled, from any thread. */
+{
+	private:
+		mutex lock;
+		vector<SQueryStats> queries;	// the first STATS_QUERIES_MAX
+		SQueryStats total;
+		unsigned long count;
+
+	public:
+		CStatsLog();
+
+		void Record( SQueryStats * stats );
+		void Reset(void);
+		unsigned long size(void);
+		string JSON( bool per_query ); // the totals, and each query if 'per_query'
+};
+
+void EnableStats( CStatsLog * log ); // from now on queries are counted into 'log'; null switches counting off
+
+class CStatsScope
+/* Counts what the calling thread does while it lives as one query on 'seg', and records it when it goes,
+ * if counting is on and no query is being counted already (an inner scope just adds to the outer one).
+ * 'FindPath', 'OptimizePath' and 'FindRoute' open one each; work they hand to a thread pool is not counted. */
+{
+	private:
+		SQueryStats stats;
+		CStatsLog * log;
+		double started;
+
+	public:
+		template <class T> CStatsScope( SSegT<T> seg );
+		CStatsScope( const CStatsScope & ) = delete;
+		CStatsScope & operator=( const CStatsScope & ) = delete;
+		~CStatsScope();
+};
+
+double StatsMicros(void); // a steady clock, in microseconds
+
+/// Query arenas ///////////////////////////////////////////////////////
+
+#define ARENA_CHUNK		16384		// bytes in the first chunk of an arena; each further chunk doubles,
+#define ARENA_CHUNK_MAX	1048576		// up to this many
+
+class CArena
+/* Memory for the paths built while answering a query, which are copied and dropped long before it ends.
+ * Allocating bumps a pointer, freeing does nothing, and 'Release' drops it all in one go.
+ * 'Release' keeps the last (largest) chunk, so an arena reused query after query soon stops calling malloc.
+ * Not thread safe: each thread needs its own. */
+{
+	private:
+		vector<char *> chunks;
+		size_t used, capacity;	// of the last chunk
+		size_t next_size;		// of the chunk to allocate next
+		size_t held;			// in all the chunks
+
+		void * Grow( size_t bytes );
+
+	public:
+		CArena();
+		CArena( const CArena & ) = delete;
+		CArena & operator=( const CArena & ) = delete;
+		~CArena();
+
+		void * Allocate( size_t bytes, size_t align );
+		void Release(void);
+		size_t Capacity(void); // bytes held
+};
+
+inline void * CArena::Allocate( size_t bytes, size_t align )
+{
+	size_t at = ( this->used + align - 1 ) & ~( align - 1 );
+	if ( at + bytes > this->capacity )
+		return this->Grow(bytes);
+	this->used = at + bytes;
+	return this->chunks.back() + at;
+}
+
+template <class T>
+class CArenaAllocator
+/* Lets the standard containers take their memory from an arena (or from the heap, without one).
+ * A container moved into another hands over its arena along with its nodes. */
+{
+	public:
+		typedef T value_type;
+		typedef true_type propagate_on_container_move_assignment;
+		typedef true_type propagate_on_container_swap;
+
+		CArena * arena;
+
+		CArenaAllocator( CArena * arena = 0 ) : arena(arena) {}
+		template <class U> CArenaAllocator( const CArenaAllocator<U> & other ) : arena(other.arena) {}
+
+		T * allocate( size_t n )
+		{
+			if ( this->arena )
+				return (T *)this->arena->Allocate( n * sizeof(T), alignof(T) );
+			return (T *)::operator new( n * sizeof(T) );
+		}
+		void deallocate( T * p, size_t n )
+		{
+			if ( !this->arena )
+				::operator delete(p);
+		}
+		template <class U> bool operator==( const CArenaAllocator<U> & other ) const { return this->arena == other.arena; }
+		template <class U> bool operator!=( const CArenaAllocator<U> & other ) const { return this->arena != other.arena; }
+};
+
+template <class T> using CArenaPathT = list< CPairT<T>, CArenaAllocator< CPairT<T> > >; // a path built during a query
+typedef CArenaPathT<float> CArenaPath;
+typedef vector< int, CArenaAllocator<int> > CArenaInts; // obstacle and edge numbers looked at during a query
+template <class T> using CArenaIsectsT = list< SIsectDataT<T>, CArenaAllocator< SIsectDataT<T> > >;
+
+template <class T> int ObstacleIntersection( SSegT<T> seg, CObstacleT<T> * obstacle, CArenaIsectsT<T> * isects, float tolerance ); // its scratch in the arena of 'isects'
+
+template <class T> void PrintPath( CArenaPathT<T> * path );
+
+/// Path finding ///////////////////////////////////////////////////////
+
+template <class T> int Circumvent( int entry, int exit, CObstacleT<T> * obstacle, bool clockwise, CArenaPathT<T> * route );
+template <class T> list< CPairT<T> > Circumvent( SSegT<T> seg, CObstacleT<T> * obstacle, bool clockwise );
+template <class T> typename SCoord<T>::real SegLen( CPairT<T> start, CPairT<T> end );
+template <class T> typename SCoord<T>::real PathLen( list< CPairT<T> > * ptlist );
+template <class T> typename SCoord<T>::real PathLen( CArenaPathT<T> * ptlist );
+template <class T> list< CPairT<T> > minCircumvent( SSegT<T> seg, CObstacleT<T> * obstacle );
+
+template <class T>
+struct SPathKeyT
+/* Identifies a 'FindPath' subproblem: the segment (bit for bit, with the flags of its end points),
+ * the first obstacle still to be considered, and the tolerance. */
+{
+	unsigned int bits[ ( 4 * sizeof(T) + sizeof(float) ) / sizeof(unsigned int) ];
+	unsigned char flags[2];
+	int first;
+
+	bool operator==( const SPathKeyT & other ) const
+	{
+		return ( memcmp( this->bits, other.bits, sizeof(this->bits) ) == 0 and this->first == other.first
+				 and this->flags[0] == other.flags[0] and this->flags[1] == other.flags[1] );
+	}
+};
+
+template <class T>
+struct SPathKeyHashT
+{
+	size_t operator()( const SPathKeyT<T> & key ) const
+	{
+		size_t h = key.first;
+		for ( unsigned int b : key.bits )
+			h = h * 1000003 ^ b;
+		return h * 31 + ( key.flags[0] << 8 | key.flags[1] );
+	}
+};
+
+template <class T>
+class CPathMemoT
+/* Remembers the routes 'FindPath' has already found for a query, so that identical subsegments
+ * (and the shortcuts 'OptimizePath' tries again after each change) are solved only once.
+ * Only valid for the one obstacle index it is used with. */
+{
+	private:
+		typedef SPathKeyT<T> SPathKey;
+		typedef CArenaPathT<T> CArenaPath;
+		typedef unordered_map< SPathKey, CArenaPath, SPathKeyHashT<T>, equal_to<SPathKey>,
+							   CArenaAllocator< pair<const SPathKey, CArenaPath> > > TRouteMap;
+		CArena arena;		// holds the table and the routes, until 'clear'
+		TRouteMap routes;
+
+	public:
+		CPathMemoT();
+		CPathMemoT( const CPathMemoT & ) = delete;
+		CPathMemoT & operator=( const CPathMemoT & ) = delete;
+
+		static SPathKey Key( SSegT<T> seg, int first, float tolerance );
+
+		bool Find( SPathKey key, CArenaPath * route );
+		bool Contains( SPathKey key );
+		void Store( SPathKey key, CArenaPath * route );
+		unsigned int size(void);
+		void clear(void);
+};
+
+typedef SPathKeyT<float> SPathKey;
+typedef CPathMemoT<float> CPathMemo;
+
+template <class T> CArenaPathT<T> FindPath( typename SSegArg<T>::type seg, CObstacleIndexT<T> * index, int first, float tolerance, CPathMemoT<T> * memo, CArena * arena );
+template <class T> list< CPairT<T> > FindPath( typename SSegArg<T>::type seg, CObstacleIndexT<T> * index, int first, float tolerance, CPathMemoT<T> * memo );
+template <class T> list< CPairT<T> > FindPath( typename SSegArg<T>::type seg, CObstacleIndexT<T> * index, float tolerance, CPathMemoT<T> * memo );
+template <class T> list< CPairT<T> > FindPath( typename SSegArg<T>::type seg, list< CObstacleT<T> > * obstacles, float tolerance );
+template <class T> list< CPairT<T> > FindPath( typename SSegArg<T>::type seg, list< CObstacleT<T> > * obstacles );
+
+/// Thread pool ////////////////////////////////////////////////////////
+
+class CThreadPool
+/* A fixed set of worker threads, each with its own task queue.
+ * A worker runs its newest task first, and when its queue is empty it steals the oldest task of another. */
+{
+	private:
+		struct SWorkQueue
+		{
+			mutex lock;
+			deque< function<void(int)> > tasks;
+		};
+		vector<thread> threads;
+		vector<SWorkQueue *> queues;
+		mutex lock;					// guards the counts below
+		condition_variable wake, idle;
+		int queued, pending;		// tasks not yet taken, and tasks not yet finished
+		unsigned int next;			// the queue the next task goes to
+		bool stopping;
+
+		bool Take( int worker, function<void(int)> * task );
+		void Run( int worker );
+
+	public:
+		CThreadPool( unsigned int threads ); // 0 means one per hardware thread
+		CThreadPool( const CThreadPool & ) = delete;
+		CThreadPool & operator=( const CThreadPool & ) = delete;
+		~CThreadPool();
+
+		unsigned int size(void);
+		void Submit( function<void(int)> task ); // 'task' is passed the number of the worker running it
+		void Wait(void); // returns once every submitted task has finished
+};
+
+/// Path optimization //////////////////////////////////////////////////
+
+struct SBudget
+/* How long an anytime query may go on improving its route: until 'deadline' (on the 'StatsMicros' clock),
+ * and for at most 'shortcuts' shortcut tries. Either may be 0 for no limit. */
+{
+	double deadline;
+	unsigned long shortcuts;
+};
+
+template <class T> bool CornerCuttable( CPairT<T> anchor, CPairT<T> candidate, CPairT<T> pt );
+template <class T> void PrefetchShortcuts( typename CArenaPathT<T>::iterator pt, CArenaPathT<T> * sequence, CObstacleIndexT<T> * index, float tolerance,
+						CPathMemoT<T> * memo, CThreadPool * pool, vector< CPathMemoT<T> > * scratch, vector<CArena> * arenas );
+template <class T> bool OptimizePath( CArenaPathT<T> * sequence, CObstacleIndexT<T> * index, float tolerance, CPathMemoT<T> * memo, CThreadPool * pool, CArena * arena, SBudget * budget );
+template <class T> bool OptimizePath( CArenaPathT<T> * sequence, CObstacleIndexT<T> * index, float tolerance, CPathMemoT<T> * memo, CThreadPool * pool, CArena * arena );
+template <class T> bool OptimizePath( list< CPairT<T> > * sequence, CObstacleIndexT<T> * index, float tolerance, CPathMemoT<T> * memo, CThreadPool * pool );
+template <class T> bool OptimizePath( list< CPairT<T> > * sequence, CObstacleIndexT<T> * index, float tolerance, CPathMemoT<T> * memo );
+template <class T> bool OptimizePath( list< CPairT<T> > * sequence, list< CObstacleT<T> > * obstacles, float tolerance );
+
+/// Visibility graph solver ////////////////////////////////////////////
+
+enum ESolver { SOLVER_CIRCUMVENT, SOLVER_VISIBILITY }; // the engines behind 'FindRoute'
+
+#define NAV_MAGIC		"PFNAV"		// first bytes of a navigation file (with the terminating zero)
+#define NAV_VERSION		1
+#define NAV_SECTIONS	5			// the arrays a navigation file holds, each with its checksum
+
+struct SNavHeader
+/* The start of a navigation file: a visibility graph, as 'CVisibilityGraphT::Save' writes it. It is followed by
+ * 	int32 sizes[obstacles]			distinct vertices of each obstacle
+ * 	T     corners[6 * nodes]		x of every node, then y; the same for the vertex before each, then after
+ * 	int32 adj_start[nodes + 1]
+ * 	int32 adj[edges]				both ways round
+ * 	real  adj_len[edges]			(as 'SCoord<T>::real')
+ * each padded to a multiple of 8 bytes, in the byte order of the machine, so the graph is used straight
+ * from a shared read-only mapping: processes mapping the same file share one copy in the page cache. */
+{
+	char magic[8];
+	unsigned int version;
+	unsigned int coords;			// sizeof(T), plus 256 for fixed point
+	unsigned long long scene;		// 'SceneHash' of the obstacles the graph was built over
+	unsigned int obstacles, nodes, edges, reserved;
+	unsigned long long sums[NAV_SECTIONS];	// 'NavChecksum' of each array
+	unsigned long long check;		// of the header up to here
+};
+
+size_t NavAlign( size_t bytes ); // 'bytes' rounded up to a multiple of 8
+unsigned long long NavChecksum( const void * data, size_t bytes ); // FNV-1a, 8 bytes at a time ('bytes' a multiple of 8)
+template <class T> unsigned long long SceneHash( CObstacleIndexT<T> * index ); // of the obstacles' numbers and vertices
+
+template <class T>
+class CVisibilityGraphT
+/* A reduced visibility graph over the obstacles of an index, searched with A*.
+ * Every obstacle is treated as a closed polygon (whether or not its first point is repeated at the end).
+ * Only convex corners can be turned at on a shortest route, and only along lines tangent to the
+ * obstacle there, so the graph keeps just those corners and the tangent edges between them.
+ * Building it costs a visibility test per pair of corners; each query then only connects its
+ * own end points. A graph can be saved to a navigation file and later mapped back from it instead,
+ * as long as the obstacles are the same. */
+{
+	private:
+		typedef CPairT<T> CPair;
+		typedef SSegT<T> SSeg;
+
+		CObstacleIndexT<T> * index;
+		int num;					// number of nodes
+		unsigned int num_adj;
+		const int * sizes;			// number of distinct vertices of each obstacle
+		const T * corners;			// the convex corners, with their neighbours along the obstacle (see 'SNavHeader')
+		const int * adj_start, * adj;	// edges of node 'i' are adj[ adj_start[i] ... adj_start[i+1]-1 ]
+		const typename SCoord<T>::real * adj_len;
+		vector<int> own_sizes, own_adj_start, own_adj;	// what the arrays point to, when the graph was built
+		vector<T> own_corners;
+		vector<typename SCoord<T>::real> own_adj_len;
+		void * map;					// ... and the navigation file, when it was mapped
+		size_t map_size;
+
+		CVisibilityGraphT( CObstacleIndexT<T> * index, void * map, size_t map_size ); // see 'Load'
+		static int Size( CObstacleT<T> * obstacle ); // what 'sizes' holds for it (0 for a removed one)
+		CPair Node( int i );
+		bool Inside( int n, double x, double y ); // whether (x,y) lies strictly inside obstacle 'n'
+		bool Tangent( int node, CPair from ); // whether the line 'from'-'node' stays outside at 'node'
+
+	public:
+		CVisibilityGraphT( CObstacleIndexT<T> * index );
+		CVisibilityGraphT( const CVisibilityGraphT & ) = delete;
+		CVisibilityGraphT & operator=( const CVisibilityGraphT & ) = delete;
+		~CVisibilityGraphT();
+		static CVisibilityGraphT * Load( string path, CObstacleIndexT<T> * index ); // null unless the file holds a graph over these very obstacles
+		bool Save( string path );
+
+		unsigned int size(void); // number of nodes
+		unsigned int Edges(void);
+		bool Mapped(void); // whether the graph was loaded from a file
+		bool Visible( CPair p, CPair q ); // whether the segment 'p'-'q' keeps out of every obstacle
+		list<CPair> FindPath( SSeg seg ); // the shortest route from 'seg.start' to 'seg.end'
+		void Tree( CPair goal, vector<double> * cost, vector<int> * toward ); // shortest routes from every node to 'goal'
+		list<CPair> FindPath( CPair start, CPair goal, vector<double> * cost, vector<int> * toward ); // along a 'Tree' to 'goal'
+};
+
+typedef CVisibilityGraphT<float> CVisibilityGraph;
+
+template <class T>
+struct STrackedRouteT
+/* A route a scene keeps up to date as its obstacles change. */
+{
+	SSegT<T> seg;
+	float tolerance;
+	list< CPairT<T> > route;
+	SBoxT<T> box;		// around the route's waypoints
+	bool live;
+};
+
+#define SCENE_CHANGES_MAX	4096	// changes a scene remembers, for those catching up with it (see 'Changes')
+
+template <class T>
+class CSceneT
+/* An obstacle set ready to answer queries: it owns a copy of the obstacles
+ * and keeps whatever has been prebuilt over them.
+ * Obstacles can be inserted, updated and removed (by their number in the index), and the routes
+ * the scene has been asked to track are then repaired where the change gets in their way,
+ * or where they went round an obstacle that has gone. Changes must not run alongside queries. */
+{
+	private:
+		typedef CPairT<T> CPair;
+		typedef SSegT<T> SSeg;
+		typedef CObstacleT<T> CObstacle;
+		typedef CObstacleIndexT<T> CObstacleIndex;
+		typedef CVisibilityGraphT<T> CVisibilityGraph;
+
+		list<CObstacle> obstacles;
+		vector<typename list<CObstacle>::iterator> slots;	// by obstacle number
+		CObstacleIndex * index;
+		CVisibilityGraph * graph;
+		vector< STrackedRouteT<T> > routes;
+		unsigned long version;
+		vector<int> changes;			// the obstacle each version changed, from version 'changes_base' on
+		unsigned long changes_base;
+
+		void Changed( int number );
+		bool Live( int number ); // whether 'number' is that of an obstacle not removed
+		int Repair( CObstacle * removed, CObstacle * added );
+
+	public:
+		CSceneT( list<CObstacle> * obstacles );
+		CSceneT( const CSceneT & ) = delete;
+		CSceneT & operator=( const CSceneT & ) = delete;
+		~CSceneT();
+
+		list<CObstacle> * Obstacles(void);
+		CObstacleIndex * Index(void);
+		CVisibilityGraph * Graph(void); // built on first use
+		bool LoadGraph( string path ); // maps the graph from a navigation file instead, if it was saved for these obstacles
+		bool SaveGraph( string path ); // writes the graph (building it first if need be) to a navigation file
+		void Prepare( ESolver solver ); // builds what 'solver' needs ahead of the first query
+		bool Prepared( ESolver solver ); // whether 'solver' can run with nothing left to build
+		unsigned long Version(void); // changes with every change to the obstacles
+		bool Changes( unsigned long since, vector<int> * numbers ); // the obstacles changed since version 'since', if still known
+
+		int Insert( CObstacle * obstacle, int * number ); // these three return the number of tracked routes repaired, or -1 (and change nothing) if 'number' is not a live obstacle's
+		int Update( int number, CObstacle * obstacle );
+		int Remove( int number );
+
+		int Track( SSeg seg, float tolerance ); // plans a route (as 'FindRoute' with SOLVER_CIRCUMVENT) and keeps it up to date
+		list<CPair> * Route( int route ); // null once untracked
+		void Untrack( int route );
+};
+
+typedef STrackedRouteT<float> STrackedRoute;
+typedef CSceneT<float> CScene;
+
+template <class T> list< CPairT<T> > FindRoute( typename SSegArg<T>::type seg, CSceneT<T> * scene, ESolver solver, float tolerance, CPathMemoT<T> * memo, CArena * arena );
+template <class T> list< CPairT<T> > FindRoute( typename SSegArg<T>::type seg, CSceneT<T> * scene, ESolver solver, float tolerance, CPathMemoT<T> * memo );
+template <class T> list< CPairT<T> > FindRoute( typename SSegArg<T>::type seg, CSceneT<T> * scene, ESolver solver, float tolerance );
+template <class T> list< CPairT<T> > FindRoute( typename SSegArg<T>::type seg, CSceneT<T> * scene, float tolerance, SBudget * budget, bool * optimized ); // anytime, as SOLVER_CIRCUMVENT
+
+/// Batch queries //////////////////////////////////////////////////////
+
+template <class T> vector< list< CPairT<T> > > FindRoutes( vector< SSegT<T> > * queries, CSceneT<T> * scene, ESolver solver, float tolerance, CThreadPool * pool );
+template <class T> vector< list< CPairT<T> > > FindRoutes( vector< SSegT<T> > * queries, CSceneT<T> * scene, ESolver solver, float tolerance );
+
+/// Hierarchical planner ///////////////////////////////////////////////
+
+#define REGION_PORTALS	2	// portals kept on each side two regions share (fewer where obstacles leave no room)
+
+template <class T>
+class CRegionMapT
+/* A coarse layer over a scene, for long queries. The extent of the obstacles is cut into square regions,
+ * and each side two regions share gets portals: points clear of the bounding box of every obstacle.
+ * The route between every two portals of a region is planned once, when the map is built; a query then
+ * searches these with A*, plans afresh only its legs from its start to a portal of its region and from
+ * a portal of its goal's region, and has 'OptimizePath' smooth the route where the pieces join.
+ * Queries whose ends lie in the same or neighbouring regions, or that no portals connect, go to 'FindRoute'.
+ * The routes are shortest through the portals, not over the scene. Once the scene changes, queries
+ * go to 'FindRoute' until the map is built again. Any number of threads may query at once. */
+{
+	private:
+		typedef CPairT<T> CPair;
+		typedef SSegT<T> SSeg;
+
+		CSceneT<T> * scene;
+		unsigned long version;			// of the scene, when the map was built
+		float tolerance;
+		double x0, y0, side;
+		int nx, ny;
+		vector<CPair> portals;
+		vector< vector<int> > members;	// the portals of each region
+		vector<int> adj_start, adj, adj_route;	// edges of portal 'i' are adj[ adj_start[i] ... adj_start[i+1]-1 ]
+		vector<typename SCoord<T>::real> adj_len;
+		vector< list<CPair> > routes;	// each between two portals of a region, from the lower-numbered one
+		vector<int> route_from;
+
+		int Region( CPair pt, int * i, int * j ); // the region 'pt' lies in (or the nearest, outside the map)
+		bool Free( CPair pt ); // whether 'pt' lies outside the bounding box of every obstacle
+		void Append( list<CPair> * route, int r, int from ); // adds route 'r', walked from portal 'from'
+
+	public:
+		CRegionMapT( CSceneT<T> * scene, double side, float tolerance, CThreadPool * pool ); // 'side' as 'Value' reads it; plans on 'pool', if any
+		CRegionMapT( const CRegionMapT & ) = delete;
+		CRegionMapT & operator=( const CRegionMapT & ) = delete;
+
+		unsigned int size(void); // number of portals
+		unsigned int Routes(void); // number of routes between portals
+		list<CPair> FindPath( SSeg seg );
+};
+
+typedef CRegionMapT<float> CRegionMap;
+
+template <class T> list< CPairT<T> > FindRoute( typename SSegArg<T>::type seg, CRegionMapT<T> * regions );
+
+/// Occupancy grid /////////////////////////////////////////////////////
+
+#define GRID_MARGIN		2	// free cells kept around the obstacles on every side of a grid
+#define GRID_SNAP_RINGS	4	// how far from a blocked cell a query end looks for a free one to start from
+
+template <class T>
+class CGridMapT
+/* A fast approximate engine: the obstacles of a scene rasterized into square cells, one bit each
+ * (kept both by row and by column, so that a jump along either scans 64 cells at a time),
+ * searched with Jump Point Search (8 directions, no cutting of corners) and then smoothed by 'OptimizePath'
+ * against the polygons themselves. A cell is blocked if any obstacle touches it, so every move between
+ * the centres of free cells keeps clear of the obstacles. The routes are only as good as the cells are fine.
+ * 'Refresh' catches up with changes to the scene, rasterizing again only the obstacles that changed;
+ * until then queries go to 'FindRoute'. Any number of threads may query at once, but not while refreshing. */
+{
+	private:
+		typedef CPairT<T> CPair;
+		typedef SSegT<T> SSeg;
+
+		CSceneT<T> * scene;
+		unsigned long version;			// of the scene, when last refreshed
+		float tolerance;
+		double x0, y0, cell;
+		int nx, ny, words, twords;		// 'words' per row of 'bits', 'twords' per column of 'tbits'
+		vector<unsigned long long> bits, tbits;	// set for the blocked cells (and beyond the grid), by row and by column
+		vector<unsigned short> cover;	// how many obstacles touch each cell
+		vector< vector<unsigned int> > cells;	// those each obstacle touches, by its number
+
+		void Rasterize( CObstacleT<T> * obstacle, vector<unsigned int> * cells );
+		void Cover( int number, int delta ); // adds 'delta' to the cover of the cells of obstacle 'number'
+		bool Free( int x, int y ); // false outside the grid
+		int Line( vector<unsigned long long> * lines, int words, int count, int line, int pos, int dir, int goal );
+		bool Jump( int x, int y, int dx, int dy, int gx, int gy, int * jx, int * jy );
+		bool Snap( CPair pt, int * x, int * y ); // the nearest free cell to 'pt', within GRID_SNAP_RINGS
+		CPair Centre( int x, int y );
+
+	public:
+		CGridMapT( CSceneT<T> * scene, double cell, float tolerance ); // 'cell' as 'Value' reads it
+		CGridMapT( const CGridMapT & ) = delete;
+		CGridMapT & operator=( const CGridMapT & ) = delete;
+
+		int Width(void);
+		int Height(void);
+		unsigned int Blocked(void); // number of blocked cells
+		int Refresh(void); // returns the number of obstacles rasterized again
+		list<CPair> FindPath( SSeg seg );
+};
+
+typedef CGridMapT<float> CGridMap;
+
+template <class T> list< CPairT<T> > FindRoute( typename SSegArg<T>::type seg, CGridMapT<T> * grid );
+
+/// Route cache ////////////////////////////////////////////////////////
+
+struct SRouteCacheStats
+{
+	unsigned long hits, misses;
+	unsigned long invalidated;	// entries dropped because the scene changed
+	unsigned long evicted;		// entries dropped to stay within the capacity
+	unsigned int size;
+};
+
+template <class T>
+struct SRouteKeyT
+/* Identifies a route in a route cache: the whole query as 'FindPath' keys it, and the engine. */
+{
+	SPathKeyT<T> path;
+	ESolver solver;
+
+	bool operator==( const SRouteKeyT & other ) const
+	{
+		return ( this->path == other.path and this->solver == other.solver );
+	}
+};
+
+template <class T>
+struct SRouteKeyHashT
+{
+	size_t operator()( const SRouteKeyT<T> & key ) const
+	{
+		return SPathKeyHashT<T>()( key.path ) * 31 + key.solver;
+	}
+};
+
+template <class T>
+class CRouteCacheT
+/* Remembers the last 'capacity' routes found on a scene, by their end points, engine and tolerance,
+ * and answers a repeated query with a copy. With a grid 'step', both end points are first moved
+ * to the nearest grid point, and the route is found (and remembered) between those instead,
+ * so that queries whose ends share grid points share a route.
+ * Every entry is forgotten once the scene's version changes. Any number of threads may query at once
+ * (the scene itself not changing meanwhile); a miss runs the solver without holding the cache. */
+{
+	private:
+		struct SEntry
+		{
+			SRouteKeyT<T> key;
+			list< CPairT<T> > route;
+		};
+		typedef list<SEntry> TEntries;
+
+		CSceneT<T> * scene;
+		unsigned int capacity;
+		double step;
+		mutex lock;					// guards everything below
+		TEntries entries;			// most recently used first
+		unordered_map< SRouteKeyT<T>, typename TEntries::iterator, SRouteKeyHashT<T> > keys;
+		unsigned long version;		// of the scene, when the entries were found
+		SRouteCacheStats stats;
+
+		void Validate(void); // forgets everything if the scene has changed
+		static SRouteKeyT<T> Key( SSegT<T> seg, ESolver solver, float tolerance );
+
+	public:
+		CRouteCacheT( CSceneT<T> * scene, unsigned int capacity, double step );
+		CRouteCacheT( const CRouteCacheT & ) = delete;
+		CRouteCacheT & operator=( const CRouteCacheT & ) = delete;
+
+		CSceneT<T> * Scene(void);
+		SSegT<T> Snap( SSegT<T> seg ); // 'seg' with its end points on the grid (unchanged without one)
+		bool Find( SSegT<T> seg, ESolver solver, float tolerance, list< CPairT<T> > * route ); // 'seg' as snapped
+		void Store( SSegT<T> seg, ESolver solver, float tolerance, list< CPairT<T> > * route, unsigned long version );
+		SRouteCacheStats Stats(void);
+		void clear(void);
+};
+
+typedef SRouteKeyT<float> SRouteKey;
+typedef CRouteCacheT<float> CRouteCache;
+
+template <class T> list< CPairT<T> > FindRoute( typename SSegArg<T>::type seg, CRouteCacheT<T> * cache, ESolver solver, float tolerance );
+
+/// Goal maps //////////////////////////////////////////////////////////
+
+template <class T>
+class CGoalMapT
+/* Shortest routes from anywhere to one fixed goal. Building runs Dijkstra outward from the goal over
+ * the scene's visibility graph, which leaves every corner with its distance to the goal and the next
+ * corner on the way there: a shortest-path tree. A query then only picks the corner its start heads for,
+ * the one that minimises the straight line to it plus its distance, and follows the tree from there.
+ * The corners are tried in that order and the first the start sees is the best, so a query usually
+ * tests the visibility of a handful of corners however many starts have come before.
+ * Once the scene changes, queries go to 'FindRoute' until the map is built again.
+ * Any number of threads may query at once. */
+{
+	private:
+		typedef CPairT<T> CPair;
+
+		CSceneT<T> * scene;
+		unsigned long version;			// of the scene, when the map was built
+		CPair goal;
+		vector<double> cost;			// of each graph node, to the goal (HUGE_VAL if there is no route)
+		vector<int> toward;				// the next node from each on the way to the goal (-1 for the goal itself)
+
+	public:
+		CGoalMapT( CSceneT<T> * scene, CPair goal );
+		CGoalMapT( const CGoalMapT & ) = delete;
+		CGoalMapT & operator=( const CGoalMapT & ) = delete;
+
+		CPair Goal(void);
+		unsigned int Reached(void); // number of graph nodes with a route to the goal
+		list<CPair> FindPath( CPair start );
+};
+
+typedef CGoalMapT<float> CGoalMap;
+
+template <class T> list< CPairT<T> > FindRoute( CPairT<T> start, CGoalMapT<T> * goals );
+
+/// Tiled scenes ///////////////////////////////////////////////////////
+
+#define TILES_RESIDENT		64		// tiles a tiled scene keeps loaded between queries, by default
+#define TILES_FAULT_AROUND	65536	// bytes around a page fault the kernel may map too (its 'fault_around_bytes')
+
+struct SSceneHeader;
+
+template <class T>
+class CTileStoreT
+/* The obstacles of a tiled scene while they are not loaded: a binary scene file, mapped read-only.
+ * Each obstacle goes to the tile of a square grid that the centre of its box lies in. The store keeps
+ * only the bounds of each tile's obstacles, with a hierarchy over them; the vertices stay in the file,
+ * and only the pages of the tile being loaded are mapped in, for as long as it takes to copy them. */
+{
+	private:
+		const SSceneHeader * map;
+		size_t map_size;
+		const unsigned int * offsets;	// of the file: the vertices of obstacle 'n' are offsets[n] ... offsets[n+1]-1
+		const float * xs, * ys;
+		double x0, y0, side;		// where the grid starts, and the side of a tile
+		int nx, ny;
+		vector< SBoxT<T> > bounds;	// of the obstacles of each tile
+		vector<unsigned int> first;	// the obstacles of tile 't' are members[first[t]] ... members[first[t+1]-1]
+		vector<unsigned int> members;	// obstacle numbers of the file, by tile (in file order within each)
+		vector<int> order;			// the tiles with obstacles, as the leaves of 'nodes' cover them
+		vector< SBVHNodeT<T> > nodes;
+
+		CTileStoreT( const SSceneHeader * map, size_t map_size, double side );
+		void Release( int tile ); // lets the system drop the pages of the file 'tile' was read from
+
+	public:
+		static CTileStoreT * Open( string path, double side ); // null if 'path' is no valid binary scene; 'side' in file units
+		CTileStoreT( const CTileStoreT & ) = delete;
+		CTileStoreT & operator=( const CTileStoreT & ) = delete;
+		~CTileStoreT();
+
+		unsigned int size(void); // number of tiles
+		unsigned int Obstacles( int tile ); // number of obstacles in 'tile'
+		int Tiles( SSegT<T> seg, vector<int> * tiles ); // sets the (sorted) tiles with obstacles 'seg' may meet
+		void Load( int tile, list< CObstacleT<T> > * obstacles, vector<int> * numbers ); // appends its obstacles, and their file numbers
+};
+
+template <class T>
+class CTiledSceneT
+/* A scene too large to keep loaded whole. Its obstacles stay in a tile store, and only the tiles that
+ * a query's segments pass through are loaded, into an obstacle index that 'FindPath' and 'OptimizePath'
+ * search as any other. Before each query the least recently used tiles are dropped, down to 'max_resident'
+ * (a single query may load more), so memory and work follow the routes rather than the size of the world.
+ * In the index, each obstacle keeps its number in the file, and a segment's candidates are all loaded
+ * before the index looks for them, so a route does not depend on which tiles earlier queries left
+ * resident: it is the route 'FindRoute' with SOLVER_CIRCUMVENT finds on the whole file, as 'LoadSceneBinary'
+ * reads it. Queries must run one at a time, and without a thread pool. */
+{
+	private:
+		struct STile
+		{
+			bool resident;
+			unsigned long used;		// the last query that needed it
+			list< CObstacleT<T> > obstacles;	// while it is resident
+			vector<int> numbers;	// of its obstacles, in the file and in the index
+		};
+
+		CTileStoreT<T> * store;
+		CObstacleIndexT<T> * index;
+		vector<STile> tiles;
+		vector<int> resident;		// the resident tiles
+		unsigned int max_resident;
+		unsigned long queries;
+		vector<int> hits;			// scratch for 'Page'
+
+		void Drop( int tile );
+
+	public:
+		CTiledSceneT( CTileStoreT<T> * store, unsigned int max_resident );
+		CTiledSceneT( const CTiledSceneT & ) = delete;
+		CTiledSceneT & operator=( const CTiledSceneT & ) = delete;
+		~CTiledSceneT();
+
+		CObstacleIndexT<T> * Index(void);
+		unsigned int Resident(void); // number of tiles loaded
+		void Page( SSegT<T> seg ); // loads the tiles with obstacles 'seg' may meet (the index calls this)
+		void Trim(void); // starts a query: drops the least recently used tiles beyond 'max_resident'
+};
+
+typedef CTileStoreT<float> CTileStore;
+typedef CTiledSceneT<float> CTiledScene;
+
+template <class T> list< CPairT<T> > FindRoute( typename SSegArg<T>::type seg, CTiledSceneT<T> * scene, float tolerance ); // as SOLVER_CIRCUMVENT
+
+/// Shared scenes //////////////////////////////////////////////////////
+
+#define SCENE_READERS_MAX	64	// reader threads a shared scene takes at once
+
+template <class T>
+class CSharedSceneT
+/* A scene that changes while it is being queried. It publishes snapshots: immutable scenes, prepared for
+ * one engine. A reader pins the current one without taking a lock (it stores the epoch it pins at in a slot
+ * of its own, then loads the snapshot), and may query it for as long as it likes. Writers, one at a time,
+ * stage insertions, updates and removals; 'Publish' builds a new snapshot off to the side, swaps it in and
+ * retires the old one, which is freed once no reader pinned at or before its retirement is left (epoch-based
+ * reclamation). So readers never wait for writers, and writers never wait for readers: a reader that stays
+ * pinned only keeps old snapshots alive. Obstacle numbers are the shared scene's; each snapshot numbers
+ * its own obstacles afresh. */
+{
+	private:
+		struct SSlot
+		{
+			atomic<unsigned long> epoch;	// the one pinned at, or ~0 when not pinned
+			atomic<bool> taken;
+			char pad[64 - sizeof(atomic<unsigned long>) - sizeof(atomic<bool>)];	// a cache line each, so readers do not share them
+		};
+		struct SRetired
+		{
+			CSceneT<T> * scene;
+			unsigned long epoch;		// when it was swapped out
+		};
+
+		ESolver solver;
+		atomic<CSceneT<T> *> current;
+		atomic<unsigned long> epoch;
+		SSlot slots[SCENE_READERS_MAX];
+		mutex lock;						// serialises writers, and guards everything below
+		vector< CObstacleT<T> > staged;	// by number, as the next snapshot will have them
+		vector<char> live;
+		vector<SRetired> retired;
+		unsigned long version;
+
+		void Reclaim(void); // frees the retired snapshots no reader can still hold
+
+	public:
+		CSharedSceneT( list< CObstacleT<T> > * obstacles, ESolver solver );
+		CSharedSceneT( const CSharedSceneT & ) = delete;
+		CSharedSceneT & operator=( const CSharedSceneT & ) = delete;
+		~CSharedSceneT(); // no reader may still be pinned
+
+		ESolver Solver(void); // the engine the snapshots are prepared for (others must not be used on them)
+		int Join(void); // a reader slot for the calling thread, or -1 if all are taken
+		void Leave( int reader );
+		CSceneT<T> * Pin( int reader ); // the current snapshot, valid until 'Unpin'
+		void Unpin( int reader );
+
+		int Insert( CObstacleT<T> * obstacle ); // these three stage a change for the next 'Publish'
+		bool Update( int number, CObstacleT<T> * obstacle ); // false (staging nothing) if 'number' is not a live obstacle's
+		bool Remove( int number ); // likewise
+		unsigned long Publish(void); // returns the new version
+		unsigned long Version(void); // of the snapshot published last
+		unsigned int Retired(void); // snapshots not yet freed
+};
+
+typedef CSharedSceneT<float> CSharedScene;
+
+template <class T> list< CPairT<T> > FindRoute( typename SSegArg<T>::type seg, CSharedSceneT<T> * scene, int reader, float tolerance ); // on a pinned snapshot
+
+/// Scene files ////////////////////////////////////////////////////////
+
+#define SCENE_MAGIC		"PFSCENE"	// first bytes of a binary scene file (with the terminating zero)
+#define SCENE_VERSION	1
+
+struct SSceneHeader
+/* The start of a binary scene file. It is followed by
+ * 	uint32 offsets[obstacles + 1]	the first vertex of each obstacle (and the total)
+ * 	float  x[vertices], y[vertices]
+ * 	float  queries[4 * queries]		start x, start y, end x, end y
+ * all in the byte order of the machine, and all 4-byte aligned, so the file can be used straight from a mapping. */
+{
+	char magic[8];
+	unsigned int version, obstacles, vertices, queries;
+};
+
+bool LoadSceneText( string path, list<CObstacle> * obstacles, vector<SSeg> * queries );
+bool LoadSceneBinary( string path, list<CObstacle> * obstacles, vector<SSeg> * queries );
+const SSceneHeader * MapSceneBinary( string path, size_t * size ); // a checked read-only mapping of the file, or null
+bool LoadScene( string path, list<CObstacle> * obstacles, vector<SSeg> * queries );
+bool SaveSceneBinary( string path, list<CObstacle> * obstacles, vector<SSeg> * queries );
+
+/// Query server ///////////////////////////////////////////////////////
+
+#define SERVER_LINE_MAX			4096	// longest request line a server reads
+#define SERVER_BACKLOG			16		// connections a socket server lets wait
+#define SERVER_MEMO_MAX			65536	// a worker's memo is emptied when it grows past this many routes
+#define SERVER_PENDING_MAX		1024	// requests of one session in the pool before it stops reading more
+#define SERVER_OUTBOX_MAX		1048576	// bytes of answers a session queues for a slow client before it stops reading
+#define SERVER_CONNECTIONS_MAX	64		// connections a socket server serves at once
+
+unsigned long ServeQueries( CScene * scene, int in, int out, float tolerance, CThreadPool * pool ); // returns the queries answered
+bool ServeSocket( CScene * scene, string path, float tolerance, CThreadPool * pool ); // returns only if the socket fails
+
+#endif
@@ -0,0 +1,214 @@
+/*
+ * SceneFile.cxx
+ *
+ * Copyright 2015 Joseph Lindgren <joseph.lindgren@uky.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/*
+ * Loading and saving scenes: the obstacles and the queries to run among them.
+ *
+ * The text format has one item per line ('#' starts a comment):
+ * 	obstacle x1 y1 x2 y2 ... xn yn		a polygon (the first point need not be repeated)
+ * 	query sx sy ex ey					a route to find, from (sx,sy) to (ex,ey)
+ *
+ * The binary format (see 'SSceneHeader') holds the same data as flat arrays,
+ * so a file is mapped into memory and its vertices copied in bulk, with no parsing.
+ * Either way every polygon comes out closed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "PathFinder.h"
+
+
+bool LoadSceneText( string path, list<CObstacle> * obstacles, vector<SSeg> * queries )
+/* Nothing is added to 'obstacles' and 'queries' unless the whole file reads. */
+{
+	FILE * file = fopen( path.c_str(), "rb" );
+	if ( !file )
+		return false;
+	string text;
+	char buffer[65536];
+	size_t got;
+	while ( (got = fread( buffer, 1, sizeof(buffer), file )) > 0 )
+		text.append( buffer, got );
+	fclose(file);
+
+	list<CObstacle> read_obstacles;
+	vector<SSeg> read_queries;
+	vector<float> x, y, coords;
+	const char * line = text.c_str(), * stop = line + text.size();
+	while ( line < stop )
+	{
+		const char * eol = (const char *)memchr( line, '\n', stop - line );
+		if ( !eol )
+			eol = stop;
+		const char * hash = (const char *)memchr( line, '#', eol - line );
+		string words( line, hash ? hash : eol );
+		line = eol + 1;
+
+		// the keyword, then the numbers
+		const char * p = words.c_str();
+		while ( *p == ' ' or *p == '\t' or *p == '\r' )
+			p ++;
+		if ( *p == 0 )
+			continue;
+		const char * key = p;
+		while ( *p and *p != ' ' and *p != '\t' )
+			p ++;
+		string keyword( key, p );
+
+		coords.clear();
+		while ( true )
+		{
+			char * end;
+			float value = strtof( p, &end );
+			if ( end == p )
+				break;
+			coords.push_back(value);
+			p = end;
+		}
+		while ( *p == ' ' or *p == '\t' or *p == '\r' )
+			p ++;
+		if ( *p != 0 )
+			return false; // not a number
+
+		if ( keyword == "obstacle" and coords.size() >= 2 and coords.size() % 2 == 0 )
+		{
+			x.clear(), y.clear();
+			for ( unsigned int i = 0; i < coords.size(); i += 2 )
+				x.push_back( coords[i] ), y.push_back( coords[i+1] );
+			read_obstacles.push_back( CObstacle( x.data(), y.data(), x.size(), true ) );
+		}
+		else if ( keyword == "query" and coords.size() == 4 )
+			read_queries.push_back( { CPair( coords[0], coords[1] ), CPair( coords[2], coords[3] ) } );
+		else
+			return false;
+	}
+	obstacles->splice( obstacles->end(), read_obstacles );
+	queries->insert( queries->end(), read_queries.begin(), read_queries.end() );
+	return true;
+}
+
+const SSceneHeader * MapSceneBinary( string path, size_t * size )
+/* Maps a binary scene file read-only, once its header, its size and its offsets check out;
+ * null otherwise. The caller unmaps it ('size' bytes). */
+{
+	int fd = open( path.c_str(), O_RDONLY );
+	if ( fd < 0 )
+		return 0;
+	struct stat info;
+	if ( fstat( fd, &info ) != 0 or info.st_size < (off_t)sizeof(SSceneHeader) )
+	{
+		close(fd);
+		return 0;
+	}
+	*size = info.st_size;
+	void * map = mmap( 0, *size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close(fd);
+	if ( map == MAP_FAILED )
+		return 0;
+
+	const SSceneHeader * header = (const SSceneHeader *)map;
+	bool ok = ( memcmp( header->magic, SCENE_MAGIC, sizeof(header->magic) ) == 0 and header->version == SCENE_VERSION
+				and *size == sizeof(SSceneHeader) + 4 * ( (size_t)header->obstacles + 1 + 2 * (size_t)header->vertices
+															+ 4 * (size_t)header->queries ) );
+	if ( ok )
+	{
+		const unsigned int * offsets = (const unsigned int *)( header + 1 );
+		ok = ( offsets[0] == 0 and offsets[header->obstacles] == header->vertices );
+		for ( unsigned int n = 0; ok and n < header->obstacles; n ++ )
+			ok = ( offsets[n] <= offsets[n+1] );
+	}
+	if ( !ok )
+	{
+		munmap( map, *size );
+		return 0;
+	}
+	return header;
+}
+
+bool LoadSceneBinary( string path, list<CObstacle> * obstacles, vector<SSeg> * queries )
+{
+	size_t size;
+	const SSceneHeader * header = MapSceneBinary( path, &size );
+	if ( !header )
+		return false;
+	const unsigned int * offsets = (const unsigned int *)( header + 1 );
+	const float	* x = (const float *)( offsets + header->obstacles + 1 ),
+				* y = x + header->vertices,
+				* q = y + header->vertices;
+	for ( unsigned int n = 0; n < header->obstacles; n ++ )
+		obstacles->push_back( CObstacle( x + offsets[n], y + offsets[n], offsets[n+1] - offsets[n], true ) );
+	for ( unsigned int n = 0; n < header->queries; n ++, q += 4 )
+		queries->push_back( { CPair( q[0], q[1] ), CPair( q[2], q[3] ) } );
+	munmap( (void *)header, size );
+	return true;
+}
+
+bool LoadScene( string path, list<CObstacle> * obstacles, vector<SSeg> * queries )
+/* Loads a scene in either format, telling them apart by the first bytes of the file. */
+{
+	char magic[sizeof(SCENE_MAGIC)] = { 0 };
+	FILE * file = fopen( path.c_str(), "rb" );
+	if ( !file )
+		return false;
+	bool binary = ( fread( magic, 1, sizeof(magic), file ) == sizeof(magic) and memcmp( magic, SCENE_MAGIC, sizeof(magic) ) == 0 );
+	fclose(file);
+	return ( binary ? LoadSceneBinary( path, obstacles, queries ) : LoadSceneText( path, obstacles, queries ) );
+}
+
+bool SaveSceneBinary( string path, list<CObstacle> * obstacles, vector<SSeg> * queries )
+{
+	SSceneHeader header;
+	vector<unsigned int> offsets = { 0 };
+	vector<float> x, y, q;
+	for ( CObstacle & obstacle : *obstacles )
+	{
+		SPtsView pts = obstacle.Pts();
+		x.insert( x.end(), pts.x, pts.x + pts.n );
+		y.insert( y.end(), pts.y, pts.y + pts.n );
+		if ( pts.n > 1 and ( pts.x[0] != pts.x[pts.n-1] or pts.y[0] != pts.y[pts.n-1] ) )
+			x.push_back( pts.x[0] ), y.push_back( pts.y[0] );
+		offsets.push_back( x.size() );
+	}
+	for ( SSeg & seg : *queries )
+		q.insert( q.end(), { seg.start.GetX(), seg.start.GetY(), seg.end.GetX(), seg.end.GetY() } );
+
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, SCENE_MAGIC, sizeof(SCENE_MAGIC) );
+	header.version = SCENE_VERSION;
+	header.obstacles = obstacles->size();
+	header.vertices = x.size();
+	header.queries = queries->size();
+
+	FILE * file = fopen( path.c_str(), "wb" );
+	if ( !file )
+		return false;
+	bool ok = ( fwrite( &header, sizeof(header), 1, file ) == 1
+				and fwrite( offsets.data(), 4, offsets.size(), file ) == offsets.size()
+				and fwrite( x.data(), 4, x.size(), file ) == x.size()
+				and fwrite( y.data(), 4, y.size(), file ) == y.size()
+				and fwrite( q.data(), 4, q.size(), file ) == q.size() );
+	return ( fclose(file) == 0 and ok );
+}
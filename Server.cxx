@@ -0,0 +1,303 @@
+/*
+ * Server.cxx
+ *
+ * Copyright 2015 Joseph Lindgren <joseph.lindgren@uky.edu>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/*
+ * Serving queries on a scene that stays loaded (and prebuilt) between them,
+ * over a pair of file descriptors (stdin/stdout) or the connections to a Unix domain socket.
+ *
+ * The protocol has one line per request and per response:
+ * 	ID SX SY EX EY [c|v]		find a route from (SX,SY) to (EX,EY), circumventing (c, the default)
+ * 								or on the visibility graph (v)
+ * 	ID N X1 Y1 ... XN YN		the route, as N points
+ * 	ID error					the request could not be read (or a coordinate is not finite), or asked for an engine the server has not built
+ * The ID is any word of the client's choosing. Requests may be sent without waiting for the answers:
+ * they are answered concurrently, each as soon as it is done, so the answers may come back in another order.
+ * Blank lines and lines starting with '#' are skipped; "quit" ends the session.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "PathFinder.h"
+
+
+struct SSession
+/* One client's stream of requests, answered by the workers of a pool. The workers only queue the answers:
+ * a writer of the session's own sends them, so a client that is slow to read holds up no worker. */
+{
+	int out;
+	bool socket;				// whether 'out' is a socket (written with 'send', so a gone client raises no signal)
+	mutex lock;					// guards everything below
+	condition_variable idle;	// for the requests to be answered
+	condition_variable ready;	// for the writer: answers queued, or the session closing
+	condition_variable room;	// for the reader: the queues have shrunk
+	unsigned long pending;		// requests not yet answered
+	deque<string> outbox;		// answers not yet written
+	size_t queued;				// bytes in 'outbox'
+	bool closing;				// no more answers will come
+	bool broken;				// writing failed, so answers are dropped
+};
+
+struct SConnections
+/* The connections a socket server is serving. */
+{
+	mutex lock;
+	condition_variable changed;
+	int active;
+};
+
+bool WriteAll( SSession * session, const char * data, size_t size )
+{
+	while ( size > 0 )
+	{
+		ssize_t wrote = ( session->socket ? send( session->out, data, size, MSG_NOSIGNAL ) : write( session->out, data, size ) );
+		if ( wrote < 0 and errno == EINTR )
+			continue;
+		if ( wrote <= 0 )
+			return false;
+		data += wrote, size -= wrote;
+	}
+	return true;
+}
+
+string Answer( string id, CScene * scene, string line, float tolerance, CPathMemo * memo, CArena * arena )
+/* The response line to the request 'line' (whose first word, 'id', has been read off already). */
+{
+	float sx, sy, ex, ey;
+	char engine[8] = "c", rest[2];
+	int got = sscanf( line.c_str(), "%*s %f %f %f %f %7s %1s", &sx, &sy, &ex, &ey, engine, rest );
+	ESolver solver = ( string(engine) == "v" ? SOLVER_VISIBILITY : SOLVER_CIRCUMVENT );
+	if ( got < 4 or got > 5 or ( string(engine) != "c" and string(engine) != "v" )
+		 or !isfinite(sx) or !isfinite(sy) or !isfinite(ex) or !isfinite(ey)
+		 or ( solver == SOLVER_VISIBILITY and !scene->Prepared(solver) ) )
+		return id + " error\n";
+
+	list<CPair> route = FindRoute( { CPair(sx, sy), CPair(ex, ey) }, scene, solver, tolerance, memo, arena );
+	string answer = id + " " + to_string( route.size() );
+	char number[64];
+	for ( CPair & pt : route )
+	{
+		snprintf( number, sizeof(number), " %.9g %.9g", pt.GetX(), pt.GetY() );
+		answer += number;
+	}
+	return answer + "\n";
+}
+
+void Queue( SSession * session, string answer )
+{
+	lock_guard<mutex> hold( session->lock );
+	if ( session->broken )
+		return;
+	session->queued += answer.size();
+	session->outbox.push_back( move(answer) );
+	session->ready.notify_one();
+}
+
+void WriteAnswers( SSession * session )
+/* The session's writer: sends whatever is queued, in one go, until the session closes with nothing left. */
+{
+	unique_lock<mutex> hold( session->lock );
+	while ( true )
+	{
+		session->ready.wait( hold, [&]{ return !session->outbox.empty() or session->closing; } );
+		if ( session->outbox.empty() )
+			break;
+		string batch;
+		for ( string & answer : session->outbox )
+			batch += answer;
+		session->outbox.clear();
+		hold.unlock();
+		bool ok = WriteAll( session, batch.data(), batch.size() );
+		hold.lock();
+		session->queued -= batch.size();
+		if ( !ok )
+		{
+			session->broken = true;
+			session->outbox.clear();
+			session->queued = 0;
+		}
+		session->room.notify_all();
+	}
+}
+
+unsigned long ServeQueries( CScene * scene, int in, int out, float tolerance, CThreadPool * pool )
+/* Reads requests from 'in' until it ends (or "quit"), hands each to 'pool' as it arrives,
+ * and writes the answers to 'out'; returns once every request read has been answered.
+ * Each worker keeps a memo for the session, as the scene does not change while serving,
+ * and an arena it releases after each request. Reading pauses while too many requests are
+ * pending or too many answers are waiting for the client to take them. */
+{
+	SSession session;
+	int type;
+	socklen_t len = sizeof(type);
+	session.out = out;
+	session.socket = ( getsockopt( out, SOL_SOCKET, SO_TYPE, &type, &len ) == 0 );
+	session.pending = 0;
+	session.queued = 0;
+	session.closing = false;
+	session.broken = false;
+	vector<CPathMemo> memos( pool->size() );
+	vector<CArena> arenas( pool->size() );
+	unsigned long answered = 0;
+	thread writer( WriteAnswers, &session );
+
+	string buffer;
+	char chunk[65536];
+	bool done = false, skipping = false;	// 'skipping' the rest of a line too long to be a request
+	while ( !done )
+	{
+		{
+			unique_lock<mutex> hold( session.lock );
+			session.room.wait( hold, [&]{ return session.broken or ( session.pending < SERVER_PENDING_MAX
+																	 and session.queued < SERVER_OUTBOX_MAX ); } );
+			if ( session.broken )
+				break;
+		}
+		ssize_t got = read( in, chunk, sizeof(chunk) );
+		if ( got < 0 and errno == EINTR )
+			continue;
+		if ( got <= 0 )
+			break;
+		buffer.append( chunk, got );
+
+		size_t start = 0, eol;
+		while ( !done and ( eol = buffer.find( '\n', start ) ) != string::npos )
+		{
+			string line = buffer.substr( start, eol - start );
+			start = eol + 1;
+			if ( skipping or line.size() >= SERVER_LINE_MAX )
+			{
+				if ( !skipping )
+					Queue( &session, "- error\n" );
+				skipping = false;
+				continue;
+			}
+			if ( !line.empty() and line.back() == '\r' )
+				line.pop_back();
+			char id[SERVER_LINE_MAX];
+			if ( line.empty() or line[0] == '#' or sscanf( line.c_str(), "%s", id ) != 1 )
+				continue;
+			if ( string(id) == "quit" )
+			{
+				done = true;
+				break;
+			}
+
+			{
+				lock_guard<mutex> hold( session.lock );
+				session.pending ++;
+			}
+			answered ++;
+			string name = id;
+			pool->Submit( [=, &session, &memos, &arenas]( int worker )
+				{
+					CPathMemo & memo = memos[worker];
+					if ( memo.size() > SERVER_MEMO_MAX )
+						memo.clear();
+					string answer = Answer( name, scene, line, tolerance, &memo, &arenas[worker] );
+					arenas[worker].Release();
+					Queue( &session, answer );
+					lock_guard<mutex> hold( session.lock );
+					session.room.notify_all();
+					if ( -- session.pending == 0 )
+						session.idle.notify_all();
+				} );
+		}
+		buffer.erase( 0, start );
+		if ( buffer.size() >= SERVER_LINE_MAX and !skipping )
+		{
+			Queue( &session, "- error\n" );
+			skipping = true;
+		}
+		if ( skipping )
+			buffer.clear();
+	}
+
+	{
+		unique_lock<mutex> hold( session.lock );
+		session.idle.wait( hold, [&]{ return session.pending == 0; } );
+		session.closing = true;
+		session.ready.notify_one();
+	}
+	writer.join();
+	return answered;
+}
+
+bool ServeSocket( CScene * scene, string path, float tolerance, CThreadPool * pool )
+/* Listens on a Unix domain socket at 'path' (replacing any file there), serving each connection
+ * on a thread of its own; their requests share the workers of 'pool'. Once SERVER_CONNECTIONS_MAX
+ * are being served, further clients wait in the backlog until one of them ends. */
+{
+	struct sockaddr_un address;
+	if ( path.size() >= sizeof(address.sun_path) )
+		return false;
+	int listener = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if ( listener < 0 )
+		return false;
+	memset( &address, 0, sizeof(address) );
+	address.sun_family = AF_UNIX;
+	strcpy( address.sun_path, path.c_str() );
+	unlink( path.c_str() );
+	if ( bind( listener, (struct sockaddr *)&address, sizeof(address) ) != 0 or listen( listener, SERVER_BACKLOG ) != 0 )
+	{
+		close(listener);
+		return false;
+	}
+
+	SConnections connections;
+	connections.active = 0;
+	while ( true )
+	{
+		{
+			unique_lock<mutex> hold( connections.lock );
+			connections.changed.wait( hold, [&]{ return connections.active < SERVER_CONNECTIONS_MAX; } );
+		}
+		int client = accept( listener, 0, 0 );
+		if ( client < 0 )
+		{
+			if ( errno == EINTR or errno == ECONNABORTED )
+				continue;
+			break;
+		}
+		{
+			lock_guard<mutex> hold( connections.lock );
+			connections.active ++;
+		}
+		thread( [=, &connections]
+			{
+				ServeQueries( scene, client, client, tolerance, pool );
+				close(client);
+				lock_guard<mutex> hold( connections.lock );
+				connections.active --;
+				connections.changed.notify_all();
+			} ).detach();
+	}
+
+	// the connections still being served refer to 'connections'
+	close(listener);
+	unique_lock<mutex> hold( connections.lock );
+	connections.changed.wait( hold, [&]{ return connections.active == 0; } );
+	return false;
+}
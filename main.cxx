@@ -0,0 +1,187 @@
+/*
+ * main.cxx
+ * 
+ * Copyright 2015 Joseph Lindgren <joseph.lindgren@uky.edu>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+
+/* 
+ * Demo: finds a route around two obstacles and prints it, along with
+ * some (almost correct) WxMaxima code to visualize the result.
+ */
+
+#include "PathFinder.h"
+
+
+/// MAIN ///////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	//Options: "--visibility" searches the visibility graph instead of circumventing obstacles;
+	// "--scene FILE" takes the obstacles and the query from a scene file (text or binary)
+	// instead of the test data below; "--save FILE" writes the scene out in the binary format;
+	// "--stats" prints what the query cost, as JSON, at the end;
+	// "--serve" answers queries on the scene from stdin to stdout instead (see Server.cxx for the protocol),
+	// and "--socket PATH" on a Unix domain socket ("--visibility" then builds the graph up front);
+	// "--nav FILE" maps the visibility graph from a navigation file, or builds it and writes FILE
+	// if that holds no graph for these obstacles.
+	ESolver solver = SOLVER_CIRCUMVENT;
+	string scene_file, save_file, socket_path, nav_file;
+	CStatsLog stats;
+	bool print_stats = false, serve = false;
+	for ( int i = 1; i < argc; i ++ )
+	{
+		string opt = argv[i];
+		if ( opt == "--visibility" )
+			solver = SOLVER_VISIBILITY;
+		else if ( opt == "--scene" and i + 1 < argc )
+			scene_file = argv[++ i];
+		else if ( opt == "--save" and i + 1 < argc )
+			save_file = argv[++ i];
+		else if ( opt == "--stats" )
+			print_stats = true;
+		else if ( opt == "--serve" )
+			serve = true;
+		else if ( opt == "--socket" and i + 1 < argc )
+			socket_path = argv[++ i];
+		else if ( opt == "--nav" and i + 1 < argc )
+			nav_file = argv[++ i];
+		else
+		{
+			cerr << "usage: " << argv[0] << " [--visibility] [--scene FILE] [--save FILE] [--stats] [--nav FILE] [--serve | --socket PATH]" << endl;
+			return 1;
+		}
+	}
+
+	//Test Data
+	list<CPair> 	Obstacle1 =
+	{ CPair(24,6), CPair(28,6), CPair(28,12), CPair(26,17), CPair(25,19),
+	  CPair(23,25), CPair(21,30), CPair(19,34), CPair(15,34), CPair(14,31),
+	  CPair(14,26), CPair(15,22), CPair(19,12), CPair(20,5) },
+					Obstacle2 = { CPair(10,10), CPair(15,2), CPair(12,15) };
+
+	CObstacle 	obstacle1(&Obstacle1),
+				obstacle2(&Obstacle2);
+
+	//Package obstacles in a list for processing convenience.
+	list<CObstacle> obs_list = { obstacle1, obstacle2 };
+	vector<SSeg> queries = { { CPair(6,7), CPair(32,23) } };
+
+	//... or load them
+	if ( !scene_file.empty() )
+	{
+		obs_list.clear(), queries.clear();
+		if ( !LoadScene( scene_file, &obs_list, &queries ) or ( queries.empty() and !serve and socket_path.empty() ) )
+		{
+			cerr << "could not load a scene with a query from " << scene_file << endl;
+			return 1;
+		}
+	}
+	if ( !save_file.empty() and !SaveSceneBinary( save_file, &obs_list, &queries ) )
+	{
+		cerr << "could not save the scene to " << save_file << endl;
+		return 1;
+	}
+
+	//Serve queries, with the scene kept prebuilt between them
+	if ( serve or !socket_path.empty() )
+	{
+		CScene scene(&obs_list);
+		CThreadPool pool(0);
+		if ( !nav_file.empty() and !scene.LoadGraph(nav_file) and !scene.SaveGraph(nav_file) )
+		{
+			cerr << "could not write the navigation file " << nav_file << endl;
+			return 1;
+		}
+		scene.Prepare(solver);
+		if ( serve )
+			ServeQueries( &scene, 0, 1, 0.001, &pool );
+		else if ( !ServeSocket( &scene, socket_path, 0.001, &pool ) )
+		{
+			cerr << "could not serve on " << socket_path << endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	//Print out the obstacle data
+	cout << "Obstacles:" << endl;
+	for ( CObstacle & obstacle : obs_list )
+		obstacle.Print();
+
+	if ( print_stats )
+		EnableStats(&stats);
+
+	{//We do a quick test of the functions declared above.
+		CPair start = queries.front().start, end = queries.front().end;
+		cout << endl << "FindPath test:" << endl;
+		list<CPair> route2;
+
+		//Find an avoidance path from start to end.
+		cout << "Find a path around these obstacles from " 
+			 << start.SPrint() << " to " << end.SPrint() << " ..."
+			 << endl;
+		if ( solver == SOLVER_VISIBILITY )
+		{
+			CScene scene(&obs_list);
+			if ( !nav_file.empty() and !scene.LoadGraph(nav_file) )
+				scene.SaveGraph(nav_file);
+			route2 = FindRoute( {start, end}, &scene, solver, 0.001 );
+		}
+		else
+			route2 = FindPath( {start, end}, &obs_list );
+		cout << "Path finding complete!" << endl;
+
+		//Print out the result.
+		cout << "---------------------------" << endl
+			 << "Original route:" << endl;
+		PrintPath(&route2);
+		cout << "of length " << PathLen(&route2) << endl;
+
+		//Optimize the route by cutting empty corners.
+		OptimizePath( &route2, &obs_list, 0.001 );
+
+		//Print the optimized route.
+		cout << "---------------------------" << endl
+			 << "Optimized route is" << endl;
+		PrintPath(&route2);
+		cout << "of length " << PathLen(&route2) << endl;
+		cout << "---------------------------" << endl;
+
+		//Print out some WxMaxima code so that you can visualize what
+		// the program has done.
+		PrintWXMaxGraph(&route2, "path");
+		int n = 0;
+		for ( CObstacle & obstacle : obs_list )
+		{
+			list<CPair> obs_pts = obstacle.GetPts();
+			string blurb = ( n == 0 ? "first obstacle" : ( n == 1 ? "second obstacle" : "obstacle " + to_string(n + 1) ) );
+			cout << endl;
+			PrintWXMaxGraph(&obs_pts, blurb);
+			n ++;
+		}
+	}
+
+	if ( print_stats )
+	{
+		EnableStats(0);
+		cout << endl << stats.JSON(true) << endl;
+	}
+
+	return 0;
+}